@@ -7,76 +7,112 @@
 #include <sstream>
 #include <numeric>
 #include <algorithm>
-#include <bitset>
-#include <ox/math.h>
-#include <ox/utils.h>
+#include <climits>
 
 #define YEAR 2021
 #define DAY 03
 
 namespace day03{
-    constexpr size_t bitwidth = 12;
+    using reading_value = unsigned long long;
+    constexpr size_t max_bitwidth = sizeof(reading_value) * CHAR_BIT;
 
-    class reading : public ox::bitset_container<bitwidth> {};
+    struct reading {
+        reading_value value = 0;
+        size_t width = 0;
+
+        [[nodiscard]] bool bit(size_t i) const { return (value >> i) & 1; }
+    };
+
+    std::istream& operator>>(std::istream& in, reading& r) {
+        std::string s;
+        if (!(in >> s))
+            return in;
+        if (s.empty() || s.size() > max_bitwidth || s.find_first_not_of("01") != std::string::npos) {
+            in.setstate(std::ios::failbit);
+            return in;
+        }
+        r.width = s.size();
+        r.value = std::stoull(s, nullptr, 2);
+        return in;
+    }
+
+    constexpr reading_value width_mask(size_t width) {
+        return width >= max_bitwidth ? ~reading_value{} : (reading_value{1} << width) - 1;
+    }
 
     class bit_population_count {
-        std::vector<int> part = std::vector<int>(bitwidth);
+        std::vector<int> part;
         int total_count = 0;
     public:
         bit_population_count& operator+(const reading& r) {
-            std::transform(r.begin(), r.end(), part.begin(), part.begin(), std::plus<>( ));
+            if (part.size() < r.width)
+                part.resize(r.width);
+            for (size_t i = 0; i < r.width; i++)
+                part[i] += r.bit(i);
             total_count++;
             return *this;
         }
 
-        [[nodiscard]] unsigned common_to_integer() const {
-            reading r;
-            int half = (total_count+1)/2;
-            std::transform(part.begin(), part.end(), r.begin(), [half](int i) { return i > half; });
-            return r.to_ulong();
+        [[nodiscard]] size_t width() const {
+            return part.size();
+        }
+
+        [[nodiscard]] reading_value common_to_integer() const {
+            reading_value r = 0;
+            for (size_t i = 0; i < part.size(); i++)
+                r |= reading_value(2 * part[i] > total_count) << i;
+            return r;
         }
     };
 
-    std::pair<int, int> gamma_epsilon_rate(unsigned long l, size_t width = bitwidth) {
-        return {l, (~l) % (1 << width)};
+    std::pair<reading_value, reading_value> gamma_epsilon_rate(reading_value l, size_t width) {
+        return {l, ~l & width_mask(width)};
     }
 
-    std::vector<int> operator+(std::vector<int> total, const reading& g) {
-        total.at(g.to_ulong()) += 1;
-        return total;
+    // Readings must be sorted; every step keeps a contiguous block sharing the bits above `bit`,
+    // so the split between 0 and 1 at `bit` is a partition point.
+    // When every remaining reading agrees on `bit`, that bit filters nothing out.
+    template <typename Compare = std::greater<>>
+    reading_value recursive_decent(const std::vector<reading_value>& sorted, size_t width, Compare c = Compare()) {
+        if (sorted.empty())
+            return 0;
+        auto begin = sorted.begin();
+        auto end = sorted.end();
+        for (size_t bit = width; bit-- > 0 && std::distance(begin, end) > 1;) {
+            auto mid = std::partition_point(begin, end, [bit](reading_value v) { return !((v >> bit) & 1); });
+            if (mid == begin || mid == end)
+                continue;
+            (c(std::distance(begin, mid), std::distance(mid, end)) ? end : begin) = mid;
+        }
+        return *begin;
     }
 
-    template <std::random_access_iterator iter, typename Compare = std::greater<int>>
-    int recursive_decent(const iter true_begin, iter end, Compare c = Compare()) {
-        std::random_access_iterator auto begin = true_begin;
-        long dist;
-        while((dist = std::distance(begin, end)) > 1) {
-            iter mid = begin + dist / 2;
-            auto sum1 = std::accumulate(begin, mid, 0);
-            auto sum2 = std::accumulate(mid, end, 0);
-            if (sum1 + sum2 == 1) {
-                return std::find(begin, end, 1) - true_begin;
-            }
-            (c(sum1, sum2) ? end : begin) = mid;
-        }
-        return begin - true_begin;
+    std::vector<reading> get_readings() {
+        auto input_stream = GET_STREAM(input, reading);
+        return {input_stream.begin(), input_stream.end()};
     }
 
     void puzzle1() {
-        auto input_stream = GET_STREAM(input, reading);
-        auto final = std::accumulate(input_stream.begin(), input_stream.end(), bit_population_count());
-        auto[gamma, epsilon] = gamma_epsilon_rate(final.common_to_integer());
-        printf("gamma is %d and epsilon is %d\n", gamma, epsilon);
-        printf("their product is: %d\n", gamma * epsilon);
+        auto readings = get_readings();
+        auto final = std::accumulate(readings.begin(), readings.end(), bit_population_count());
+        auto[gamma, epsilon] = gamma_epsilon_rate(final.common_to_integer(), final.width());
+        printf("gamma is %llu and epsilon is %llu\n", gamma, epsilon);
+        // Both rates can be 64 bits wide, so the product needs 128
+        printf("their product is: %s\n", to_string((unsigned __int128) gamma * epsilon).c_str());
     }
 
     void puzzle2() {
-        auto input_stream = GET_STREAM(input, reading);
-        auto binary_tree = std::accumulate(input_stream.begin(), input_stream.end(), std::vector<int>(ox::power_of_2(bitwidth)));
-        int o2 = recursive_decent(binary_tree.begin(), binary_tree.end());
-        int co2 = recursive_decent(binary_tree.begin(), binary_tree.end(), std::less_equal<>());
-        printf("O2  is %d\n", o2);
-        printf("CO2 is %d\n", co2);
-        printf("Their product is %d\n", co2 * o2);
+        auto readings = get_readings();
+        if (readings.empty())
+            return;
+        size_t width = stdr::max(readings | stdv::transform(&reading::width));
+        std::vector<reading_value> sorted(readings.size());
+        stdr::transform(readings, sorted.begin(), &reading::value);
+        stdr::sort(sorted);
+        reading_value o2 = recursive_decent(sorted, width);
+        reading_value co2 = recursive_decent(sorted, width, std::less_equal<>());
+        printf("O2  is %llu\n", o2);
+        printf("CO2 is %llu\n", co2);
+        printf("Their product is %s\n", to_string((unsigned __int128) co2 * o2).c_str());
     }
 }
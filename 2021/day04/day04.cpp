@@ -8,89 +8,99 @@
 #include <algorithm>
 #include <ranges>
 #include <numeric>
-#include <ox/grid.h>
+#include <limits>
+#include <optional>
+#include <thread>
+#include <cstdint>
 
 #define YEAR 2021
 #define DAY 04
 
 namespace day04 {
     constexpr int bingosize = 5;
+    constexpr int bingocells = bingosize * bingosize;
     constexpr int poolsize = 99;
-    using ball_element = std::pair<int, bool> *;
-    using bingo_array = std::array<ball_element, bingosize * bingosize>;
+    using card_mask = uint32_t;
     using bingo_inputs = std::vector<int>;
+    using draw_positions = std::array<int, poolsize + 1>;
+    constexpr int never_drawn = std::numeric_limits<int>::max();
 
-    static struct number_pool {
-        using numberstate = std::pair<int, bool>;
-        std::array<numberstate, poolsize + 1> pool;
+    constexpr card_mask row_mask(int row) {
+        return ((card_mask{1} << bingosize) - 1) << (row * bingosize);
+    }
 
-        number_pool() {
-            for (int i = 0; i <= poolsize; i++) {
-                pool[i].first = i;
-            }
-        }
+    constexpr card_mask column_mask(int column) {
+        card_mask mask = 0;
+        for (int row = 0; row < bingosize; row++)
+            mask |= card_mask{1} << (row * bingosize + column);
+        return mask;
+    }
 
-        void reset() {
-            for (auto& n: pool) {
-                n.second = false;
-            }
-        }
-    } main_pool;
-
-    struct bingo_card : public ox::grid<ball_element, bingo_array> {
-        [[nodiscard]] bool check_vertical_for_win() const {
-            return stdr::any_of(
-                    stdv::iota(0, bingosize),
-                    [this](int i) { return stdr::all_of(
-                            stdv::iota(0, bingosize),
-                            [this, i](int j) { return get(i, j)->second; }
-                    );
-            });
-        }
+    struct bingo_card {
+        std::array<uint8_t, bingocells> numbers{};
 
-        [[nodiscard]] bool check_horizontal_for_win() const {
-            return std::any_of(begin(), end(), [](auto subrange) {
-                return std::all_of(subrange.first, subrange.second, [](auto &element) { return element->second; });
-            });
+        [[nodiscard]] static bool completes_line(card_mask marked, int cell) {
+            card_mask row = row_mask(cell / bingosize);
+            card_mask column = column_mask(cell % bingosize);
+            return (marked & row) == row || (marked & column) == column;
         }
 
-        [[nodiscard]] bool check_diagonal_for_win() const {
-            return stdr::all_of(stdv::iota(0, bingosize), [this](int i) { return get(i, i)->second; }) ||
-                   stdr::all_of(stdv::iota(0, bingosize), [this](int i) { return get(i, 4 - i)->second; });
+        [[nodiscard]] int get_score(card_mask marked) const {
+            int sum = 0;
+            for (int cell : stdv::iota(0, bingocells)) {
+                if (!(marked & (card_mask{1} << cell)))
+                    sum += numbers[cell];
+            }
+            return sum;
         }
 
-        [[nodiscard]] bool check_for_win() const {
-            return check_horizontal_for_win() || check_vertical_for_win() /*|| check_diagonal_for_win()*/;
+        [[nodiscard]] card_mask marked_by(const draw_positions& positions, int draw) const {
+            card_mask marked = 0;
+            for (int cell : stdv::iota(0, bingocells)) {
+                if (positions.at(numbers[cell]) <= draw)
+                    marked |= card_mask{1} << cell;
+            }
+            return marked;
         }
 
-        [[nodiscard]] int get_score() const {
-            auto unmarked = data
-                            | stdv::filter([](ball_element b) { return !b->second; })
-                            | stdv::transform([](ball_element b) { return b->first; });
-            return std::accumulate(unmarked.begin(), unmarked.end(), 0);
+        [[nodiscard]] int winning_draw(const draw_positions& positions) const {
+            int best = never_drawn;
+            for (int i : stdv::iota(0, bingosize)) {
+                int row = 0;
+                int column = 0;
+                for (int j : stdv::iota(0, bingosize)) {
+                    row = std::max(row, positions.at(numbers[i * bingosize + j]));
+                    column = std::max(column, positions.at(numbers[j * bingosize + i]));
+                }
+                best = std::min({best, row, column});
+            }
+            return best;
         }
 
-        void print_state() {
-            leveled_foreach(
-                    [](auto& elem) { printf("\033[%dm%2d\033[0m ", elem->second ? 31 : 0, elem->first); },
-                    []() { printf("\n"); });
+        void print_state(card_mask marked) const {
+            for (int cell : stdv::iota(0, bingocells)) {
+                printf("\033[%dm%2d\033[0m ", marked & (card_mask{1} << cell) ? 31 : 0, numbers[cell]);
+                if (cell % bingosize == bingosize - 1)
+                    printf("\n");
+            }
             printf("\n");
         }
-    };
 
-    std::istream &operator>>(std::istream &in, bingo_card &bc) {
-        bc.set_width(bingosize);
-        for (int i: stdv::iota(0, bingosize)) {
-            for (int j: stdv::iota(0, bingosize)) {
+        friend std::istream& operator>>(std::istream& in, bingo_card& bc) {
+            for (auto& number : bc.numbers) {
                 int x;
                 if (!(in >> x)) {
                     return in;
                 }
-                bc.get(i, j) = &main_pool.pool.at(x);
+                if (x < 0 || x > poolsize) {
+                    in.setstate(std::ios::failbit);
+                    return in;
+                }
+                number = uint8_t(x);
             }
+            return in;
         }
-        return in;
-    }
+    };
 
     bingo_inputs extract_roller(ox::ifstream_container<bingo_card> &in) {
         bingo_inputs to_return;
@@ -105,48 +115,144 @@ namespace day04 {
         return to_return;
     }
 
-    void print_final_result(bingo_card card, int ball) {
-        int score = card.get_score();
-        printf("Total Score is: %d\n", card.get_score());
+    class bingo_engine {
+        struct cell_ref {
+            int card;
+            int cell;
+        };
+
+        std::array<std::vector<cell_ref>, poolsize + 1> ball_index;
+        std::vector<card_mask> marked;
+        std::vector<bool> won;
+        size_t cards_remaining;
+    public:
+        explicit bingo_engine(const std::vector<bingo_card>& cards) :
+                marked(cards.size()), won(cards.size()), cards_remaining(cards.size()) {
+            for (int card : stdv::iota(0, int(cards.size()))) {
+                for (int cell : stdv::iota(0, bingocells)) {
+                    ball_index.at(cards[card].numbers[cell]).push_back({card, cell});
+                }
+            }
+        }
+
+        std::vector<int> call(int ball) {
+            std::vector<int> new_winners;
+            for (const auto& [card, cell] : ball_index.at(ball)) {
+                if (won[card])
+                    continue;
+                marked[card] |= card_mask{1} << cell;
+                if (bingo_card::completes_line(marked[card], cell)) {
+                    won[card] = true;
+                    cards_remaining--;
+                    new_winners.push_back(card);
+                }
+            }
+            stdr::sort(new_winners);
+            return new_winners;
+        }
+
+        [[nodiscard]] size_t remaining() const {
+            return cards_remaining;
+        }
+    };
+
+    enum class simulation_mode { incremental, single_pass };
+
+    struct bingo_winner {
+        int card;
+        int draw;
+    };
+    using bingo_winners = std::pair<std::optional<bingo_winner>, std::optional<bingo_winner>>;
+
+    draw_positions get_draw_positions(const bingo_inputs& roller) {
+        draw_positions positions;
+        positions.fill(never_drawn);
+        for (int i : stdv::iota(0, int(roller.size()))) {
+            auto& position = positions.at(roller[i]);
+            position = std::min(position, i);
+        }
+        return positions;
+    }
+
+    bingo_winners simulate_incremental(const bingo_inputs& roller, const std::vector<bingo_card>& cards) {
+        bingo_winners winners;
+        bingo_engine engine(cards);
+        for (int draw : stdv::iota(0, int(roller.size()))) {
+            auto new_winners = engine.call(roller[draw]);
+            if (new_winners.empty())
+                continue;
+            if (!winners.first)
+                winners.first = {new_winners.front(), draw};
+            winners.second = {new_winners.back(), draw};
+            if (engine.remaining() == 0)
+                break;
+        }
+        return winners;
+    }
+
+    bingo_winners simulate_single_pass(const bingo_inputs& roller, const std::vector<bingo_card>& cards) {
+        auto positions = get_draw_positions(roller);
+        std::vector<int> draws(cards.size());
+        size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+        size_t chunk_size = (cards.size() + thread_count - 1) / thread_count;
+        {
+            std::vector<std::jthread> workers;
+            for (size_t chunk_begin = 0; chunk_begin < cards.size(); chunk_begin += chunk_size) {
+                workers.emplace_back([&, chunk_begin] {
+                    size_t chunk_end = std::min(chunk_begin + chunk_size, cards.size());
+                    for (size_t i = chunk_begin; i < chunk_end; i++) {
+                        draws[i] = cards[i].winning_draw(positions);
+                    }
+                });
+            }
+        }
+
+        bingo_winners winners;
+        for (int card : stdv::iota(0, int(draws.size()))) {
+            int draw = draws[card];
+            if (draw == never_drawn)
+                continue;
+            if (!winners.first || draw < winners.first->draw)
+                winners.first = {card, draw};
+            if (!winners.second || draw >= winners.second->draw)
+                winners.second = {card, draw};
+        }
+        return winners;
+    }
+
+    void print_final_result(const bingo_card& card, const bingo_inputs& roller, bingo_winner winner) {
+        int ball = roller.at(winner.draw);
+        card_mask marked = card.marked_by(get_draw_positions(roller), winner.draw);
+        int score = card.get_score(marked);
+        card.print_state(marked);
+        printf("Total Score is: %d\n", score);
         printf("Last called was: %d\n", ball);
         printf("Their product was: %d\n", ball * score);
     }
 
     std::pair<bingo_inputs, std::vector<bingo_card>> init() {
-        main_pool.reset();
         auto input = GET_STREAM(input, bingo_card);
         return {extract_roller(input), {input.begin(), input.end()}};
     }
 
-    void puzzle1() {
+    void solve(bool last_winner, simulation_mode mode = simulation_mode::single_pass) {
         auto[roller, cards] = init();
-        for (auto ball: roller) {
-            printf("####################\nCurrent Ball: %d\n####################\n", ball);
-            main_pool.pool.at(ball).second = true;
-            for (auto card: cards) {
-                card.print_state();
-                if (card.check_for_win()) {
-                    print_final_result(card, ball);
-                    return;
-                }
-            }
+        auto winners = mode == simulation_mode::single_pass
+                ? simulate_single_pass(roller, cards)
+                : simulate_incremental(roller, cards);
+        auto winner = last_winner ? winners.second : winners.first;
+        if (!winner) {
+            printf("No card won\n");
+            return;
         }
+        print_final_result(cards[winner->card], roller, *winner);
+    }
+
+    void puzzle1() {
+        solve(false);
     }
 
     void puzzle2() {
-        auto[roller, cards] = init();
-        for (auto ball: roller) {
-            printf("####################\nCurrent Ball: %d\n####################\n", ball);
-            main_pool.pool.at(ball).second = true;
-            auto endpoint = std::remove_if(cards.begin(), cards.end(), [](auto card) {
-                card.print_state();
-                return card.check_for_win();
-            });
-            if (endpoint == cards.begin()) {
-                print_final_result(cards.front(), ball);
-                return;
-            }
-            cards.erase(endpoint, cards.end());
-        }
+        solve(true);
     }
 }
@@ -7,6 +7,12 @@
 #include <limits>
 #include <ranges>
 #include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <unordered_map>
+#include <map>
+#include <atomic>
+#include <thread>
 #include <ox/grid.h>
 
 namespace day05 {
@@ -14,59 +20,154 @@ namespace day05 {
     #define DAY 05
     namespace stdv = std::views;
     namespace stdr = std::ranges;
-    constexpr int grid_size = 1000;
+    using counter = uint8_t;
+    constexpr long sparse_area_ratio = 64;
+    // One counter per cell: the largest board the dense grid is allowed to allocate
+    constexpr long dense_area_limit = 1l << 30;
+    constexpr long sweep_point_limit = 1l << 26;
+    constexpr long print_area_limit = 1l << 12;
+    constexpr long tile_size = 256;
 
-    class point : public std::pair<int, int> {
-    public:
-        int& x = first;
-        int& y = second;
+    struct point {
+        int x;
+        int y;
+        auto operator<=>(const point& other) const = default;
     };
-    class line : public std::pair<point, point> {
-    public:
-        point& p1 = first;
-        point& p2 = second;
+    struct line {
+        point p1;
+        point p2;
 
         [[nodiscard]] bool vertical() const { return p1.x == p2.x; }
         [[nodiscard]] bool horizontal() const { return p1.y == p2.y; }
+        [[nodiscard]] bool diagonal() const { return std::abs(p2.x - p1.x) == std::abs(p2.y - p1.y); }
+        [[nodiscard]] long length() const { return std::max(std::abs(long(p2.x) - p1.x), std::abs(long(p2.y) - p1.y)) + 1; }
+        [[nodiscard]] int dx() const { return (p2.x > p1.x) - (p2.x < p1.x); }
+        [[nodiscard]] int dy() const { return (p2.y > p1.y) - (p2.y < p1.y); }
+        [[nodiscard]] bool drawn(bool diag) const { return vertical() || horizontal() || (diag && diagonal()); }
     };
 
     std::istream& operator>>(std::istream& in, line& l) {
         std::string line;
         std::getline(in, line);
-        std::sscanf(line.c_str(), "%d,%d -> %d,%d", &l.p1.x, &l.p1.y, &l.p2.x, &l.p2.y);
+        if (std::sscanf(line.c_str(), "%d,%d -> %d,%d", &l.p1.x, &l.p1.y, &l.p2.x, &l.p2.y) != 4)
+            in.setstate(std::ios::failbit);
         return in;
     }
 
-    class grid : public ox::grid<int, std::array<int, grid_size * grid_size>> {
-        int largest = 0;
+    template <typename F>
+    void rasterize(const line& l, bool diag, F&& f) {
+        if (!l.drawn(diag))
+            return;
+        for (long i : stdv::iota(0l, l.length())) {
+            f(int(l.p1.x + l.dx() * i), int(l.p1.y + l.dy() * i));
+        }
+    }
+
+    constexpr counter saturating_increment(counter c) {
+        return c == std::numeric_limits<counter>::max() ? c : counter(c + 1);
+    }
+
+    struct bounding_box {
+        int min_x = std::numeric_limits<int>::max();
+        int min_y = std::numeric_limits<int>::max();
+        int max_x = std::numeric_limits<int>::min();
+        int max_y = std::numeric_limits<int>::min();
+
+        explicit bounding_box(const std::vector<line>& lines) {
+            for (const line& l : lines) {
+                min_x = std::min({min_x, l.p1.x, l.p2.x});
+                min_y = std::min({min_y, l.p1.y, l.p2.y});
+                max_x = std::max({max_x, l.p1.x, l.p2.x});
+                max_y = std::max({max_y, l.p1.y, l.p2.y});
+            }
+        }
+
+        [[nodiscard]] long width() const { return std::max(0l, long(max_x) - min_x + 1); }
+        [[nodiscard]] long height() const { return std::max(0l, long(max_y) - min_y + 1); }
+        [[nodiscard]] long area() const { return width() * height(); }
+    };
+
+    class grid : public ox::grid<counter> {
+        int origin_x;
+        int origin_y;
         bool diag = false;
 
+        struct piece {
+            uint32_t line;
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        counter& cell(int x, int y) {
+            return data[std::size_t(y - origin_y) * width + std::size_t(x - origin_x)];
+        }
+
+        // Splits a line into runs of steps that each stay inside one tile
+        template <typename F>
+        void for_each_piece(const line& l, std::size_t tiles_x, F&& f) const {
+            long n = l.length();
+            for (long t = 0; t < n;) {
+                long x = l.p1.x - origin_x + l.dx() * t;
+                long y = l.p1.y - origin_y + l.dy() * t;
+                long span = n - 1 - t;
+                if (l.dx())
+                    span = std::min(span, l.dx() > 0 ? tile_size - 1 - x % tile_size : x % tile_size);
+                if (l.dy())
+                    span = std::min(span, l.dy() > 0 ? tile_size - 1 - y % tile_size : y % tile_size);
+                f(std::size_t(y / tile_size) * tiles_x + std::size_t(x / tile_size), t, t + span);
+                t += span + 1;
+            }
+        }
+
     public:
-        grid() : ox::grid<int, std::array<int, grid_size * grid_size>>(grid_size) {};
-        explicit grid(bool b) : ox::grid<int, std::array<int, grid_size * grid_size>>(grid_size), diag(b) {};
+        explicit grid(const bounding_box& box, bool b = false) : origin_x(box.min_x), origin_y(box.min_y), diag(b) {
+            set_width(box.width());
+            data.resize(box.area());
+        }
 
         void add_line(const line& l) {
-            largest = std::max({largest, l.p1.x, l.p1.y, l.p2.x, l.p2.y});
-            if (l.vertical()) {
-                auto horizontal = l.p1.x;
-                auto [min, max] = std::minmax(l.p1.y, l.p2.y);
-                for (int vertical : stdv::iota(min, max+1)) {
-                    get(horizontal, vertical)++;
-                }
-            } else if(l.horizontal()) {
-                auto vertical = l.p1.y;
-                auto [min, max] = std::minmax(l.p1.x, l.p2.x);
-                for (int horizontal : stdv::iota(min, max+1)) {
-                    get(horizontal, vertical)++;
-                }
-            } else if(diag) {
-                auto [left, right] = std::minmax(l.p1, l.p2);
-                int sign = right.y - left.y;
-                int length = std::abs(sign);
-                sign /= length;
-                for (int i : stdv::iota(0, length+1)) {
-                    get(left.x + i, left.y + sign * i)++;
-                }
+            rasterize(l, diag, [this](int x, int y) {
+                counter& c = cell(x, y);
+                c = saturating_increment(c);
+            });
+        }
+
+        // Every tile is rasterized by a single worker, so no cell is ever shared between threads
+        void add_lines(const std::vector<line>& lines) {
+            std::size_t tiles_x = (width + tile_size - 1) / tile_size;
+            std::size_t tiles_y = (data.size() / std::max<std::size_t>(width, 1) + tile_size - 1) / tile_size;
+            std::vector<std::size_t> bin_offsets(tiles_x * tiles_y + 1);
+            for (const line& l : lines) {
+                if (l.drawn(diag))
+                    for_each_piece(l, tiles_x, [&](std::size_t tile, long, long) { bin_offsets[tile + 1]++; });
+            }
+            std::partial_sum(bin_offsets.begin(), bin_offsets.end(), bin_offsets.begin());
+
+            std::vector<piece> pieces(bin_offsets.back());
+            std::vector<std::size_t> bin_fill(bin_offsets.begin(), bin_offsets.end() - 1);
+            for (uint32_t i = 0; i < lines.size(); i++) {
+                if (lines[i].drawn(diag))
+                    for_each_piece(lines[i], tiles_x, [&](std::size_t tile, long begin, long end) {
+                        pieces[bin_fill[tile]++] = {i, uint32_t(begin), uint32_t(end)};
+                    });
+            }
+
+            std::atomic<std::size_t> next_tile = 0;
+            unsigned thread_count = std::max(1u, std::thread::hardware_concurrency());
+            std::vector<std::jthread> workers;
+            for (unsigned i = 0; i < thread_count; i++) {
+                workers.emplace_back([&] {
+                    for (std::size_t tile; (tile = next_tile++) + 1 < bin_offsets.size();) {
+                        for (std::size_t p = bin_offsets[tile]; p < bin_offsets[tile + 1]; p++) {
+                            const line& l = lines[pieces[p].line];
+                            long stride = long(l.dy()) * long(width) + l.dx();
+                            counter* c = &cell(l.p1.x + l.dx() * int(pieces[p].begin), l.p1.y + l.dy() * int(pieces[p].begin));
+                            for (uint32_t t = pieces[p].begin; t <= pieces[p].end; t++, c += stride) {
+                                *c = saturating_increment(*c);
+                            }
+                        }
+                    }
+                });
             }
         }
 
@@ -77,28 +178,293 @@ namespace day05 {
             printf("\n");
         }
 
-        [[nodiscard]] auto count_score() const {
-            return stdr::count_if(data, [](int x) { return x >= 2; });
+        [[nodiscard]] std::size_t count_score() const {
+            return std::transform_reduce(data.begin(), data.end(), std::size_t{0}, std::plus<>(),
+                                         [](counter x) -> std::size_t { return x >= 2; });
         }
     };
 
-    void puzzle1() {
-        auto input = GET_STREAM(input, line);
-        grid g;
-        for (line l : input) {
-            g.add_line(l);
+    class sparse_grid {
+        std::unordered_map<uint64_t, counter> cells;
+        bool diag = false;
+
+    public:
+        explicit sparse_grid(long expected_points, bool b = false) : diag(b) {
+            cells.reserve(expected_points);
+        }
+
+        void add_line(const line& l) {
+            rasterize(l, diag, [this](int x, int y) {
+                counter& c = cells[uint64_t(uint32_t(x)) << 32 | uint32_t(y)];
+                c = saturating_increment(c);
+            });
+        }
+
+        [[nodiscard]] std::size_t count_score() const {
+            return stdr::count_if(cells, [](const auto& c) { return c.second >= 2; });
+        }
+    };
+
+    enum class direction { horizontal, vertical, rising, falling };
+    constexpr std::array directions{direction::horizontal, direction::vertical, direction::rising, direction::falling};
+
+    struct lattice_point {
+        long x;
+        long y;
+        auto operator<=>(const lattice_point& other) const = default;
+    };
+
+    constexpr long line_key(direction d, lattice_point p) {
+        switch (d) {
+            case direction::horizontal: return p.y;
+            case direction::vertical: return p.x;
+            case direction::rising: return p.x - p.y;
+            case direction::falling: return p.x + p.y;
         }
-        g.print_grid();
-        printf("the score is: %lu\n", g.count_score());
+        return 0;
     }
 
-    void puzzle2() {
+    constexpr long line_param(direction d, lattice_point p) {
+        return d == direction::vertical ? p.y : p.x;
+    }
+
+    constexpr lattice_point point_on(direction d, long key, long t) {
+        switch (d) {
+            case direction::horizontal: return {t, key};
+            case direction::vertical: return {key, t};
+            case direction::rising: return {t, t - key};
+            case direction::falling: return {t, key - t};
+        }
+        return {};
+    }
+
+    constexpr long positive_mod(long a, long m) {
+        return ((a % m) + m) % m;
+    }
+
+    class overlap_sweep {
+        struct interval {
+            long begin;
+            long end;
+        };
+        using coverage = std::map<long, std::vector<interval>>;
+
+        struct family {
+            coverage cover;
+            coverage doubles;
+        };
+
+        std::array<family, directions.size()> families;
+        std::size_t score = 0;
+
+        static void append(std::vector<interval>& intervals, long begin, long end) {
+            if (!intervals.empty() && intervals.back().end + 1 >= begin)
+                intervals.back().end = std::max(intervals.back().end, end);
+            else
+                intervals.push_back({begin, end});
+        }
+
+        static bool contains(const coverage& c, direction d, lattice_point p) {
+            auto on_line = c.find(line_key(d, p));
+            if (on_line == c.end())
+                return false;
+            long t = line_param(d, p);
+            auto after = stdr::upper_bound(on_line->second, t, {}, &interval::begin);
+            return after != on_line->second.begin() && std::prev(after)->end >= t;
+        }
+
+        static family build_family(const std::map<long, std::vector<interval>>& segments) {
+            family f;
+            std::vector<std::pair<long, int>> events;
+            for (const auto& [key, intervals] : segments) {
+                events.clear();
+                for (auto [begin, end] : intervals) {
+                    events.emplace_back(begin, 1);
+                    events.emplace_back(end + 1, -1);
+                }
+                stdr::sort(events);
+                int depth = 0;
+                for (auto event = events.begin(); event != events.end();) {
+                    long position = event->first;
+                    for (; event != events.end() && event->first == position; ++event)
+                        depth += event->second;
+                    if (event == events.end())
+                        break;
+                    if (depth >= 1)
+                        append(f.cover[key], position, event->first - 1);
+                    if (depth >= 2)
+                        append(f.doubles[key], position, event->first - 1);
+                }
+            }
+            return f;
+        }
+
+        // Score change for a point where families i < j cross. The point is only taken by the two
+        // lowest-indexed families covering it, so each crossing is settled exactly once without
+        // storing it. A crossing inside k collinear overlaps was already counted k times.
+        [[nodiscard]] long settle_crossing(std::size_t i, std::size_t j, lattice_point p) const {
+            for (std::size_t d = 0; d < j; d++) {
+                if (d != i && contains(families[d].cover, directions[d], p))
+                    return 0;
+            }
+            long k = stdr::count_if(directions, [&](direction d) {
+                return contains(families[std::size_t(d)].doubles, d, p);
+            });
+            return k == 0 ? 1 : 1 - k;
+        }
+
+        // Lines of family i become rows and lines of family j columns in (key_j, key_i) space, where an
+        // ordered set of active rows answers each column's range query in O(log L + hits).
+        [[nodiscard]] long crossings(std::size_t i, std::size_t j) const {
+            direction a = directions[i];
+            direction b = directions[j];
+            long total = 0;
+            struct row {
+                long key;
+                long t_begin;
+                long u_begin;
+                long u_step;
+            };
+            struct column {
+                long u;
+                long v_low;
+                long v_high;
+            };
+            struct event {
+                long u;
+                int order;
+                std::size_t index;
+                auto operator<=>(const event& other) const = default;
+            };
+
+            long modulus = std::abs(line_key(b, point_on(a, 0, 1)) - line_key(b, point_on(a, 0, 0)));
+            for (long residue : stdv::iota(0l, modulus)) {
+                std::vector<row> rows;
+                std::vector<column> columns;
+                std::vector<event> events;
+                for (const auto& [key, intervals] : families[std::size_t(a)].cover) {
+                    if (positive_mod(key, modulus) != residue)
+                        continue;
+                    for (auto [begin, end] : intervals) {
+                        long u1 = line_key(b, point_on(a, key, begin));
+                        long u2 = line_key(b, point_on(a, key, end));
+                        long step = line_key(b, point_on(a, key, begin + 1)) - u1;
+                        events.push_back({std::min(u1, u2), 0, rows.size()});
+                        events.push_back({std::max(u1, u2), 2, rows.size()});
+                        rows.push_back({key, begin, u1, step});
+                    }
+                }
+                for (const auto& [key, intervals] : families[std::size_t(b)].cover) {
+                    if (positive_mod(key, modulus) != residue)
+                        continue;
+                    for (auto [begin, end] : intervals) {
+                        auto [v1, v2] = std::minmax({line_key(a, point_on(b, key, begin)),
+                                                     line_key(a, point_on(b, key, end))});
+                        events.push_back({key, 1, columns.size()});
+                        columns.push_back({key, v1, v2});
+                    }
+                }
+                stdr::sort(events);
+
+                std::map<long, std::size_t> active;
+                for (const event& e : events) {
+                    if (e.order == 0) {
+                        active.emplace(rows[e.index].key, e.index);
+                    } else if (e.order == 2) {
+                        active.erase(rows[e.index].key);
+                    } else {
+                        const column& c = columns[e.index];
+                        for (auto it = active.lower_bound(c.v_low); it != active.end() && it->first <= c.v_high; ++it) {
+                            const row& r = rows[it->second];
+                            total += settle_crossing(i, j, point_on(a, r.key, r.t_begin + (c.u - r.u_begin) / r.u_step));
+                        }
+                    }
+                }
+            }
+            return total;
+        }
+
+    public:
+        overlap_sweep(const std::vector<line>& lines, bool diag) {
+            std::array<std::map<long, std::vector<interval>>, directions.size()> segments;
+            for (const line& l : lines) {
+                direction d;
+                if (l.horizontal())
+                    d = direction::horizontal;
+                else if (l.vertical())
+                    d = direction::vertical;
+                else if (diag && l.diagonal())
+                    d = (l.p2.x - l.p1.x) == (l.p2.y - l.p1.y) ? direction::rising : direction::falling;
+                else
+                    continue;
+                lattice_point p1{l.p1.x, l.p1.y};
+                lattice_point p2{l.p2.x, l.p2.y};
+                auto [t1, t2] = std::minmax({line_param(d, p1), line_param(d, p2)});
+                segments[std::size_t(d)][line_key(d, p1)].push_back({t1, t2});
+            }
+            for (direction d : directions) {
+                families[std::size_t(d)] = build_family(segments[std::size_t(d)]);
+            }
+
+            long total = 0;
+            for (const family& f : families) {
+                for (const auto& [_, intervals] : f.doubles) {
+                    for (auto [begin, end] : intervals)
+                        total += end - begin + 1;
+                }
+            }
+
+            for (std::size_t i = 0; i < directions.size(); i++) {
+                for (std::size_t j = i + 1; j < directions.size(); j++) {
+                    total += crossings(i, j);
+                }
+            }
+            score = total;
+        }
+
+        [[nodiscard]] std::size_t count_score() const {
+            return score;
+        }
+    };
+
+    std::vector<line> get_lines() {
         auto input = GET_STREAM(input, line);
-        grid g(true);
-        for (line l : input) {
+        return {input.begin(), input.end()};
+    }
+
+    template <typename Grid>
+    Grid rasterize_all(const std::vector<line>& lines, Grid g) {
+        for (const line& l : lines) {
             g.add_line(l);
         }
-        g.print_grid();
-        printf("the score is: %lu", g.count_score());
+        return g;
+    }
+
+    std::size_t solve(bool diag) {
+        auto lines = get_lines();
+        bounding_box box(lines);
+        auto lengths = lines | stdv::transform(&line::length);
+        long points = std::accumulate(lengths.begin(), lengths.end(), 0l);
+        if (box.area() > dense_area_limit) {
+            if (points > sweep_point_limit)
+                return overlap_sweep(lines, diag).count_score();
+            return rasterize_all(lines, sparse_grid(points, diag)).count_score();
+        }
+        if (box.area() > sparse_area_ratio * points) {
+            return rasterize_all(lines, sparse_grid(points, diag)).count_score();
+        }
+        grid g(box, diag);
+        g.add_lines(lines);
+        if (box.area() <= print_area_limit)
+            g.print_grid();
+        return g.count_score();
+    }
+
+    void puzzle1() {
+        printf("the score is: %zu\n", solve(false));
+    }
+
+    void puzzle2() {
+        printf("the score is: %zu\n", solve(true));
     }
-}
\ No newline at end of file
+}
@@ -7,29 +7,176 @@
 #include <numeric>
 #include <ranges>
 #include <array>
+#include <algorithm>
+#include <string>
 
 #define YEAR 2021
 #define DAY 06
 
 namespace day06 {
-    using count_type = long;
+    using count_type = unsigned __int128;
+    constexpr std::size_t timer_states = 9;
+    using population_vector = std::array<count_type, timer_states>;
 
-    class fish_population {
-        std::array<count_type, 9> days_count{};
-        int day = 0;
+    // Entries wrap modulo 2^128; `lost` marks the entries whose exact value no longer fits.
+    // A lost entry is at least 2^128, so anything it feeds into with a nonzero factor is lost too.
+    struct transition_matrix {
+        std::array<population_vector, timer_states> m{};
+        std::array<std::array<bool, timer_states>, timer_states> lost{};
+
+        [[nodiscard]] bool nonzero(std::size_t i, std::size_t j) const {
+            return m[i][j] || lost[i][j];
+        }
+
+        static transition_matrix identity() {
+            transition_matrix t;
+            for (std::size_t i = 0; i < timer_states; i++)
+                t.m[i][i] = 1;
+            return t;
+        }
+
+        // new[t] = old[t + 1], new[6] += old[0], new[8] = old[0]
+        static transition_matrix one_day() {
+            transition_matrix t;
+            for (std::size_t i = 0; i + 1 < timer_states; i++)
+                t.m[i][i + 1] = 1;
+            t.m[6][0] = 1;
+            t.m[8][0] = 1;
+            return t;
+        }
+
+        transition_matrix operator*(const transition_matrix& other) const {
+            transition_matrix r;
+            for (std::size_t i = 0; i < timer_states; i++) {
+                for (std::size_t k = 0; k < timer_states; k++) {
+                    if (!nonzero(i, k))
+                        continue;
+                    for (std::size_t j = 0; j < timer_states; j++) {
+                        if (!other.nonzero(k, j))
+                            continue;
+                        bool& lost_entry = r.lost[i][j];
+                        lost_entry |= lost[i][k] || other.lost[k][j];
+                        r.m[i][j] = checked_add(r.m[i][j], checked_mul(m[i][k], other.m[k][j], lost_entry), lost_entry);
+                    }
+                }
+            }
+            return r;
+        }
+
+        // `overflowed` is set when a timer that holds fish goes through a lost entry or a sum wraps
+        population_vector apply(const population_vector& v, bool& overflowed) const {
+            population_vector r{};
+            for (std::size_t i = 0; i < timer_states; i++) {
+                for (std::size_t j = 0; j < timer_states; j++) {
+                    if (!v[j])
+                        continue;
+                    overflowed |= lost[i][j];
+                    r[i] = checked_add(r[i], checked_mul(m[i][j], v[j], overflowed), overflowed);
+                }
+            }
+            return r;
+        }
+
+        [[nodiscard]] transition_matrix pow(unsigned long n) const {
+            transition_matrix result = identity();
+            transition_matrix base = *this;
+            for (; n; n >>= 1) {
+                if (n & 1)
+                    result = result * base;
+                if (n > 1)
+                    base = base * base;
+            }
+            return result;
+        }
+    };
+
+    population_vector read_histogram(std::istream& in) {
+        population_vector histogram{};
+        int i;
+        while(in >> i) {
+            histogram.at(i) += 1;
+            in.ignore(std::numeric_limits<std::streamsize>::max(), ',');
+        }
+        return histogram;
+    }
+
+    // Fish count for one (population, query day) pair; `overflowed` means the value wrapped modulo 2^128
+    struct query_total {
+        count_type value = 0;
+        bool overflowed = false;
+    };
+
+    // The population after n days is linear in the initial histogram, so each query day reduces to
+    // the descendant count of a single fish per starting timer, and each population to a dot product.
+    class population_batch {
+        std::vector<unsigned long> query_days;
+        std::vector<population_vector> descendants;
+        // Per query and starting timer: the descendant count wrapped
+        std::vector<std::array<bool, timer_states>> descendants_lost;
     public:
-        explicit fish_population(std::istream& in) {
-            int i;
-            while(in >> i) {
-                days_count.at(i) += 1;
-                in.ignore(std::numeric_limits<std::streamsize>::max(), ',');
+        explicit population_batch(std::vector<unsigned long> days) : query_days(std::move(days)) {
+            auto one_day = transition_matrix::one_day();
+            for (unsigned long day : query_days) {
+                auto transition = one_day.pow(day);
+                population_vector d{};
+                std::array<bool, timer_states> lost{};
+                for (std::size_t i = 0; i < timer_states; i++) {
+                    for (std::size_t j = 0; j < timer_states; j++) {
+                        lost[j] |= transition.lost[i][j];
+                        d[j] = checked_add(d[j], transition.m[i][j], lost[j]);
+                    }
+                }
+                descendants.push_back(d);
+                descendants_lost.push_back(lost);
+            }
+        }
+
+        [[nodiscard]] const std::vector<unsigned long>& days() const {
+            return query_days;
+        }
+
+        [[nodiscard]] std::vector<query_total> evaluate(const population_vector& histogram) const {
+            std::vector<query_total> totals(descendants.size());
+            for (std::size_t q = 0; q < descendants.size(); q++) {
+                query_total& total = totals[q];
+                for (std::size_t j = 0; j < timer_states; j++) {
+                    if (!histogram[j])
+                        continue;
+                    total.overflowed |= descendants_lost[q][j];
+                    total.value = checked_add(total.value, checked_mul(descendants[q][j], histogram[j], total.overflowed),
+                                              total.overflowed);
+                }
             }
+            return totals;
         }
 
+        [[nodiscard]] std::vector<std::vector<query_total>> evaluate(const std::vector<population_vector>& histograms) const {
+            std::vector<std::vector<query_total>> results;
+            results.reserve(histograms.size());
+            for (const auto& histogram : histograms)
+                results.push_back(evaluate(histogram));
+            return results;
+        }
+    };
+
+    class fish_population {
+        population_vector days_count{};
+        unsigned long day = 0;
+        bool overflowed = false;
+    public:
+        explicit fish_population(std::istream& in) : days_count(read_histogram(in)) {}
+
         fish_population& operator++() {
             day++;
             std::rotate(days_count.begin(), days_count.begin() + 1, days_count.end());
-            days_count.at(6) += days_count.at(8);
+            days_count.at(6) = checked_add(days_count.at(6), days_count.at(8), overflowed);
+            return *this;
+        }
+
+        fish_population& operator+=(unsigned long generations) {
+            auto transition = transition_matrix::one_day().pow(generations);
+            days_count = transition.apply(days_count, overflowed);
+            day += generations;
             return *this;
         }
 
@@ -42,19 +189,21 @@ namespace day06 {
                     printf("After   1 day:  ");
                     break;
                 default:
-                    printf("After %3d days: ", day);
+                    printf("After %3lu days: ", day);
             }
-            std::cout << std::accumulate(days_count.begin(), days_count.end(), count_type{});
-            printf(" Total\n");
+            bool wrapped = overflowed;
+            count_type total = 0;
+            for (count_type count : days_count)
+                total = checked_add(total, count, wrapped);
+            std::cout << to_string(total);
+            printf(wrapped ? " Total (mod 2^128)\n" : " Total\n");
         }
     };
 
-    void run_test(int generations) {
+    void run_test(unsigned long generations) {
         auto input = GET_STREAM(input, int);
         fish_population fishes(input);
-        for(int a : stdv::iota(0, generations)) {
-            ++fishes;
-        }
+        fishes += generations;
         fishes.print_state();
     }
 
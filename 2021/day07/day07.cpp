@@ -6,65 +6,200 @@
 #include <limits>
 #include <numeric>
 #include <ranges>
-#include <cmath>
+#include <algorithm>
+#include <concepts>
+#include <thread>
 #include <ox/math.h>
 
 #define YEAR 2021
 #define DAY 07
 
 namespace day07 {
+    struct linear_cost {
+        long operator()(long d) const { return d; }
+    };
+    struct triangular_cost {
+        long operator()(long d) const { return ox::triangle_sum(d); }
+    };
+    struct quadratic_cost {
+        long operator()(long d) const { return d * d; }
+    };
+
+    template <typename Cost>
+    concept closed_form_cost = std::same_as<Cost, linear_cost>
+                               || std::same_as<Cost, triangular_cost>
+                               || std::same_as<Cost, quadratic_cost>;
+
     class crab_positions {
-        std::vector<int> positions{};
+        long min_position = 0;
+        std::vector<long> counts{};
+        std::vector<long> count_prefix{};
+        std::vector<long> sum_prefix{};
+        long total_count = 0;
+        long total_sum = 0;
+        long total_squares = 0;
+
+        // A position outside the histogram extends it by at least its current size on that side,
+        // so any input order costs amortized O(range) without buffering the positions
+        void add(long position) {
+            if (counts.empty()) {
+                min_position = position;
+                counts.resize(1);
+            } else if (position < min_position) {
+                long grow = std::max(min_position - position, long(counts.size()));
+                counts.insert(counts.begin(), grow, 0);
+                min_position -= grow;
+            } else if (position - min_position >= long(counts.size())) {
+                counts.resize(std::max(std::size_t(position - min_position + 1), 2 * counts.size()));
+            }
+            counts[position - min_position]++;
+        }
+
+        // Number of crabs and sum of their positions at or left of x
+        [[nodiscard]] std::pair<long, long> prefix(long x) const {
+            if (x < min_position)
+                return {0, 0};
+            std::size_t i = std::min(std::size_t(x - min_position), counts.size() - 1);
+            return {count_prefix[i], sum_prefix[i]};
+        }
+
     public:
         explicit crab_positions(std::istream& in) {
             int i;
             while(in >> i) {
-                positions.push_back(i);
+                add(i);
                 in.ignore(std::numeric_limits<std::streamsize>::max(), ',');
             }
+            // Growth may overshoot the real range on either side
+            auto first = stdr::find_if(counts, [](long c) { return c != 0; });
+            auto last = std::find_if(counts.rbegin(), counts.rend(), [](long c) { return c != 0; }).base();
+            min_position += first - counts.begin();
+            counts.erase(last, counts.end());
+            counts.erase(counts.begin(), first);
+            count_prefix.resize(counts.size());
+            sum_prefix.resize(counts.size());
+            long running_count = 0;
+            long running_sum = 0;
+            for (std::size_t j = 0; j < counts.size(); j++) {
+                long position = min_position + long(j);
+                running_count += counts[j];
+                running_sum += counts[j] * position;
+                total_squares += counts[j] * position * position;
+                count_prefix[j] = running_count;
+                sum_prefix[j] = running_sum;
+            }
+            total_count = running_count;
+            total_sum = running_sum;
         }
 
-        int median() {
-            auto m = positions.begin() + positions.size()/2;
-            std::nth_element(positions.begin(), m, positions.end());
-            return positions[positions.size()/2];
+        [[nodiscard]] long max_position() const {
+            return min_position + long(counts.size()) - 1;
         }
 
-        std::pair<int, int> mean() {
-            auto m = std::accumulate(positions.begin(), positions.end(), 0.0);
-            auto mean_value = m / positions.size();
-            return {std::floor(mean_value), std::ceil(mean_value)};
+        [[nodiscard]] long median() const {
+            auto m = stdr::upper_bound(count_prefix, total_count / 2);
+            return min_position + (m - count_prefix.begin());
         }
 
-        int calculate_fuel() {
+        [[nodiscard]] long calculate_fuel() const {
             return calculate_fuel(median());
         }
 
-        int calculate_fuel(int med) {
-            auto per_crab_fuel = positions | stdv::transform([med](int a) { return std::abs(med - a); });
-            return std::accumulate(per_crab_fuel.begin(), per_crab_fuel.end(), 0);
+        [[nodiscard]] long calculate_fuel(long x) const {
+            auto [left_count, left_sum] = prefix(x);
+            return (x * left_count - left_sum) + ((total_sum - left_sum) - x * (total_count - left_count));
+        }
+
+        [[nodiscard]] long square_distances(long x) const {
+            return total_count * x * x - 2 * x * total_sum + total_squares;
         }
 
-        int calculate_fuel2(int mean) {
-            auto per_crab_fuel = positions | stdv::transform([mean](int a) { return ox::triangle_sum(std::abs(mean - a)); });
-            return std::accumulate(per_crab_fuel.begin(), per_crab_fuel.end(), 0);
+        // sum of triangle_sum(|x - p|) = (sum of (x - p)^2 + sum of |x - p|) / 2
+        [[nodiscard]] long calculate_fuel2(long x) const {
+            return (square_distances(x) + calculate_fuel(x)) / 2;
+        }
+
+        template <typename Cost>
+        [[nodiscard]] long evaluate(long x, Cost cost) const {
+            if constexpr (std::same_as<Cost, linear_cost>) {
+                return calculate_fuel(x);
+            } else if constexpr (std::same_as<Cost, triangular_cost>) {
+                return calculate_fuel2(x);
+            } else if constexpr (std::same_as<Cost, quadratic_cost>) {
+                return square_distances(x);
+            } else {
+                long total = 0;
+                for (std::size_t j = 0; j < counts.size(); j++) {
+                    if (counts[j])
+                        total += counts[j] * cost(std::abs(x - min_position - long(j)));
+                }
+                return total;
+            }
+        }
+
+        // Cost must be convex and non-decreasing in the distance, which makes the total fuel convex in x.
+        // Closed-form costs binary search the sign of the forward difference; anything else narrows the
+        // range by evaluating evenly spaced probes on separate threads.
+        template <typename Cost>
+        [[nodiscard]] std::pair<long, long> optimize(Cost cost = Cost()) const {
+            long low = min_position;
+            long high = max_position();
+            if constexpr (closed_form_cost<Cost>) {
+                while (low < high) {
+                    long mid = low + (high - low) / 2;
+                    if (evaluate(mid + 1, cost) < evaluate(mid, cost))
+                        low = mid + 1;
+                    else
+                        high = mid;
+                }
+                return {evaluate(low, cost), low};
+            } else {
+                long probes = std::max(4u, std::thread::hardware_concurrency());
+                while (true) {
+                    long span = high - low;
+                    std::vector<long> xs;
+                    if (span <= probes) {
+                        for (long x : stdv::iota(low, high + 1))
+                            xs.push_back(x);
+                    } else {
+                        for (long i : stdv::iota(0l, probes + 1))
+                            xs.push_back(low + span * i / probes);
+                    }
+
+                    std::vector<std::pair<long, long>> values(xs.size());
+                    {
+                        std::vector<std::jthread> workers;
+                        std::size_t stride = std::min<std::size_t>(xs.size(), probes);
+                        for (std::size_t first = 0; first < stride; first++) {
+                            workers.emplace_back([&, first] {
+                                for (std::size_t i = first; i < xs.size(); i += stride)
+                                    values[i] = {evaluate(xs[i], cost), xs[i]};
+                            });
+                        }
+                    }
+
+                    auto best = stdr::min_element(values);
+                    if (span <= probes)
+                        return *best;
+                    std::size_t i = best - values.begin();
+                    low = xs[i ? i - 1 : 0];
+                    high = xs[std::min(i + 1, xs.size() - 1)];
+                }
+            }
         }
     };
 
     void puzzle1() {
         auto input = GET_STREAM(input, int);
         crab_positions cp(input);
-        int med = cp.median();
-        int fuel = cp.calculate_fuel(med);
-        printf("The x position is %d\nThe fuel is %d\n", med, fuel);
+        auto [fuel, med] = cp.optimize<linear_cost>();
+        printf("The x position is %ld\nThe fuel is %ld\n", med, fuel);
     }
 
     void puzzle2() {
         auto input = GET_STREAM(input, int);
         crab_positions cp(input);
-        auto [mean1, mean2] = cp.mean();
-        auto [fuel1, fuel2] = std::make_pair(cp.calculate_fuel2(mean1), cp.calculate_fuel2(mean2));
-        auto [fuel, mean] = std::min(std::make_pair(fuel1, mean1), std::make_pair(fuel2, mean2));
-        printf("The x position is %d\nThe fuel is %d\n", mean, fuel);
+        auto [fuel, mean] = cp.optimize<triangular_cost>();
+        printf("The x position is %ld\nThe fuel is %ld\n", mean, fuel);
     }
 }
@@ -3,163 +3,108 @@
 //
 
 #include "day08.h"
-#include <sstream>
-#include <set>
 #include <algorithm>
 #include <numeric>
-#include <map>
+#include <array>
+#include <bit>
+#include <cstdint>
 #include <cassert>
+#include <vector>
+#include <iterator>
 
 #define YEAR 2021
 #define DAY 08
 
 namespace day08 {
     class signals {
-        using lights = std::set<char>;
-        struct custom_set_comp {
-            bool operator()(const lights& a, const lights& b) const {
-                if (a.size() != b.size())
-                    return a.size() < b.size();
-                return a < b;
-            }
-        };
-
-        std::map<lights, int, custom_set_comp> part1;
-        std::vector<std::pair<lights, int>> part0;
-        std::vector<lights> part2;
+        // bit i is lit when segment 'a' + i is on
+        using lights = uint8_t;
+
+        std::array<lights, 10> part1{};
+        std::array<lights, 4> part2{};
+        std::array<int8_t, 128> digit_of{};
+
+        static lights to_lights(const std::string& s) {
+            lights l = 0;
+            for (char c : s)
+                l |= lights(1u << (c - 'a'));
+            return l;
+        }
 
-        std::array<const lights*, 10> ns;
-        std::array<char, 7> character_map;
-    public:
-        void reset() {
-            ns = {};
-            character_map = {};
-            part1 = {};
-            part2.clear();
+        static bool contains(lights a, lights b) {
+            return (a & b) == b;
         }
 
+    public:
+        // Tokens are at most seven characters, so reading them never leaves the small string buffer
         friend std::istream& operator>>(std::istream& in, signals& self) {
-            self.reset();
-            std::string line;
-            getline(in, line);
-            std::istringstream ss(line);
-
             std::string part;
-            while (ss >> part && part != "|") {
-                self.part1[std::set(part.begin(), part.end())] = -1;
+            for (auto& l : self.part1) {
+                if (!(in >> part))
+                    return in;
+                l = to_lights(part);
+            }
+            if (!(in >> part) || part != "|") {
+                in.setstate(std::ios::failbit);
+                return in;
             }
-            while(ss >> part) {
-                self.part2.emplace_back(part.begin(), part.end());
+            for (auto& l : self.part2) {
+                if (!(in >> part))
+                    return in;
+                l = to_lights(part);
             }
             return in;
         }
 
         long count_2347_outputs() {
-            return stdr::count_if(part2, [](const lights& s) {
+            return stdr::count_if(part2, [](lights s) {
                 auto x = {2, 3, 4, 7};
-                return stdr::find(x, s.size()) != x.end();
+                return stdr::find(x, std::popcount(s)) != x.end();
             });
         };
 
-        static lights sub(const lights& a, const lights& b) {
-            lights out;
-            stdr::set_difference(a, b, std::inserter(out, out.begin()));
-            return out;
-        }
-        static lights sub2(const lights& a, const std::pair<lights, int>& b) { return sub(a, b.first); }
-
-        static lights add(const lights& a, const lights& b) {
-            lights out;
-            stdr::set_union(a, b, std::inserter(out, out.begin()));
-            return out;
-        }
-        static lights add2(const lights& a, const std::pair<lights, int>& b) { return add(a, b.first); }
-
-        static lights mul(const lights& a, const lights& b) {
-            lights out;
-            stdr::set_intersection(a, b, std::inserter(out, out.begin()));
-            return out;
-        }
-        static lights mul2(const lights& a, const std::pair<lights, int>& b) { return mul(a, b.first); }
-
         void solve() {
-            auto temp = part1.begin();
-            auto size2 = part1.begin();
-            auto size3 = std::find_if(size2, part1.end(), [](auto x) {return x.first.size() == 3;});
-            auto size4 = std::find_if(size3, part1.end(), [](auto x) {return x.first.size() == 4;});
-            auto size5 = std::find_if(size4, part1.end(), [](auto x) {return x.first.size() == 5;});
-            auto size6 = std::find_if(size5, part1.end(), [](auto x) {return x.first.size() == 6;});
-            auto size7 = std::find_if(size5, part1.end(), [](auto x) {return x.first.size() == 7;});
-
-            size2->second = 1; ns.at(1) = &size2->first;
-            size3->second = 7; ns.at(7) = &size3->first;
-            size4->second = 4; ns.at(4) = &size4->first;
-            size7->second = 8; ns.at(8) = &size7->first;
-
-            const lights full_set = {'a', 'b', 'c', 'd', 'e', 'f', 'e', 'g'};
-            lights set_temp1;
-            lights set_temp2;
-            lights set_temp3;
-
-            // Determining 'a'
-            set_temp1 = sub(*ns[7], *ns[1]);
-            assert(set_temp1.size() == 1);
-            character_map.at(0) = *(set_temp1.begin());
-
-            // Determining 'd'
-            set_temp1 = std::accumulate(size5, size6, full_set, mul2);
-            set_temp2 = std::accumulate(size6, size7, full_set, mul2);
-            set_temp3 = sub(set_temp1, set_temp2);
-            assert(set_temp3.size() == 1);
-            character_map.at('d' - 'a') = *(set_temp3.begin());
-
-            // Determining 0
-            temp = std::find_if(size6, size7, [this](auto x) { return !x.first.contains(character_map.at('d' - 'a')); });
-            assert(temp != size7);
-            temp->second = 0; ns.at(0) = &temp->first;
-
-            // Determining 'b'
-            set_temp1 = sub(*ns[4], *ns[1]);
-            set_temp2 = sub(set_temp1, {character_map.at('d' - 'a')});
-            assert(set_temp2.size() == 1);
-            character_map.at('b' - 'a') = *(set_temp2.begin());
-
-            // Determining '5'
-            temp = std::find_if(size5, size6, [this](auto x) { return x.first.contains(character_map.at('b' - 'a')); });
-            assert(temp != size6);
-            temp->second = 5; ns.at(5) = &temp->first;
-
-            // Determining '6'
-            temp = std::find_if(size6, size7, [this](auto x) {
-                return mul(x.first, *ns[1]).size() == 1;
-            });
-            assert(temp != size7);
-            temp->second = 6; ns.at(6) = &temp->first;
-
-            // Determining '9'
-            temp = std::find_if(size6, size7, [this](auto x) { return x.second == -1; });
-            assert(temp != size7);
-            temp->second = 9; ns.at(9) = &temp->first;
-
-            // Determining '3'
-            temp = std::find_if(size5, size6, [this](auto x) { return mul(x.first, *ns[7]) == *ns[7]; });
-            assert(temp != size6);
-            temp->second = 3; ns.at(3) = &temp->first;
-
-            // Determining '2'
-            temp = std::find_if(size5, size6, [this](auto x) { return x.second == -1; });
-            assert(temp != size6);
-            temp->second = 2; ns.at(2) = &temp->first;
+            std::array<lights, 10> ns{};
+            auto unique_size = [this](int size) { return *stdr::find(part1, size, std::popcount<lights>); };
+            ns[1] = unique_size(2);
+            ns[7] = unique_size(3);
+            ns[4] = unique_size(4);
+            ns[8] = unique_size(7);
+
+            for (lights l : part1) {
+                switch (std::popcount(l)) {
+                    case 5:
+                        if (contains(l, ns[1]))
+                            ns[3] = l;
+                        else if (std::popcount(lights(l & ns[4])) == 3)
+                            ns[5] = l;
+                        else
+                            ns[2] = l;
+                        break;
+                    case 6:
+                        if (contains(l, ns[4]))
+                            ns[9] = l;
+                        else if (contains(l, ns[1]))
+                            ns[0] = l;
+                        else
+                            ns[6] = l;
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            digit_of.fill(-1);
+            for (int digit : stdv::iota(0, 10))
+                digit_of[ns[digit]] = int8_t(digit);
         }
 
         int get_number() {
             int sum = 0;
-            int base = 1;
-            for (const auto& s : stdv::reverse(part2)) {
-                sum += base * part1[s];
-                base *= 10;
+            for (lights s : part2) {
+                assert(digit_of[s] >= 0);
+                sum = sum * 10 + digit_of[s];
             }
-            assert(sum > 0);
             return sum;
         }
 
@@ -169,21 +114,117 @@ namespace day08 {
         }
 
         void print_parts() const {
-            for (auto& s : part1) {
-                for (auto& c : s.first)
-                    printf("%c", c);
+            auto print = [](lights l) {
+                for (int i : stdv::iota(0, 7))
+                    if (l & (1u << i))
+                        printf("%c", 'a' + i);
                 printf(" ");
-            }
+            };
+            stdr::for_each(part1, print);
             printf("| ");
-            for (auto& s : part2) {
-                for (auto& c : s)
-                    printf("%c", c);
-                printf(" ");
-            }
+            stdr::for_each(part2, print);
             printf("\n");
         }
     };
 
+    // One display entry per byte lane; GCC and Clang lower these to SSE/NEON byte operations
+    constexpr std::size_t lanes = 16;
+    using lane_vector = uint8_t __attribute__((vector_size(lanes)));
+
+    lane_vector lane_popcount(lane_vector x) {
+        x = x - ((x >> 1) & 0x55);
+        x = (x & 0x33) + ((x >> 2) & 0x33);
+        return (x + (x >> 4)) & 0x0F;
+    }
+
+    template <typename Mask>
+    lane_vector select(Mask condition, lane_vector a, lane_vector b) {
+        auto mask = (lane_vector) condition;
+        return (a & mask) | (b & ~mask);
+    }
+
+    lane_vector broadcast(uint8_t value) {
+        return lane_vector{} + value;
+    }
+
+    // Entries are stored structure-of-arrays in blocks of `lanes` and decoded a block at a time.
+    // Only the masks of 1 and 4 are needed: every output digit follows from its popcount and its overlap with them.
+    class display_batch {
+        struct block {
+            std::array<lane_vector, 10> patterns{};
+            std::array<lane_vector, 4> outputs{};
+        };
+
+        std::vector<block> blocks;
+        std::size_t entries = 0;
+
+    public:
+        explicit display_batch(std::istream& in) {
+            std::string text{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+            std::size_t token = 0;
+            uint8_t mask = 0;
+            auto flush = [&] {
+                if (!mask)
+                    return;
+                if (token == 0 && entries % lanes == 0)
+                    blocks.emplace_back();
+                block& b = blocks.back();
+                std::size_t lane = entries % lanes;
+                (token < 10 ? b.patterns[token] : b.outputs[token - 10])[lane] = mask;
+                mask = 0;
+                if (++token == 14) {
+                    token = 0;
+                    entries++;
+                }
+            };
+            for (char c : text) {
+                if (c >= 'a' && c <= 'g')
+                    mask |= uint8_t(1u << (c - 'a'));
+                else
+                    flush();
+            }
+            flush();
+        }
+
+        [[nodiscard]] std::size_t size() const {
+            return entries;
+        }
+
+        // Four digits per entry, most significant first
+        [[nodiscard]] std::vector<uint8_t> decode() const {
+            std::vector<uint8_t> digits(blocks.size() * lanes * 4);
+            for (std::size_t b = 0; b < blocks.size(); b++) {
+                const block& current = blocks[b];
+                lane_vector one{};
+                lane_vector four{};
+                for (lane_vector pattern : current.patterns) {
+                    lane_vector count = lane_popcount(pattern);
+                    one |= select(count == 2, pattern, lane_vector{});
+                    four |= select(count == 4, pattern, lane_vector{});
+                }
+                for (std::size_t d = 0; d < 4; d++) {
+                    lane_vector o = current.outputs[d];
+                    lane_vector count = lane_popcount(o);
+                    auto has_one = (o & one) == one;
+                    auto has_four = (o & four) == four;
+                    lane_vector shared_four = lane_popcount(o & four);
+                    lane_vector five_segments = select(has_one, broadcast(3),
+                                                       select(shared_four == 3, broadcast(5), broadcast(2)));
+                    lane_vector six_segments = select(has_four, broadcast(9),
+                                                      select(has_one, broadcast(0), broadcast(6)));
+                    lane_vector digit = select(count == 5, five_segments, six_segments);
+                    digit = select(count == 2, broadcast(1), digit);
+                    digit = select(count == 3, broadcast(7), digit);
+                    digit = select(count == 4, broadcast(4), digit);
+                    digit = select(count == 7, broadcast(8), digit);
+                    for (std::size_t l = 0; l < lanes; l++)
+                        digits[(b * lanes + l) * 4 + d] = digit[l];
+                }
+            }
+            digits.resize(entries * 4);
+            return digits;
+        }
+    };
 
     void puzzle1() {
         auto input = GET_STREAM(input, signals);
@@ -194,8 +235,11 @@ namespace day08 {
 
     void puzzle2() {
         auto input = GET_STREAM(input, signals);
-        auto sums = input | stdv::transform([](auto x){return x.solve_and_get_number();});
-        auto x = std::accumulate(sums.begin(), sums.end(), 0);
-        printf("%d\n", x);
+        auto digits = display_batch(input).decode();
+        long x = 0;
+        for (std::size_t i = 0; i < digits.size(); i += 4) {
+            x += digits[i] * 1000 + digits[i + 1] * 100 + digits[i + 2] * 10 + digits[i + 3];
+        }
+        printf("%ld\n", x);
     }
-}
\ No newline at end of file
+}
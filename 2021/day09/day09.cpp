@@ -6,8 +6,12 @@
 #include "algorithms/_helper_iterators.h"
 #include <vector>
 #include <numeric>
-#include <queue>
-#include <unordered_set>
+#include <utility>
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <atomic>
+#include <thread>
 #include <ranges>
 #include <ox/grid.h>
 #include <ox/ranges.h>
@@ -17,6 +21,7 @@
 #define DAY 09
 
 namespace day09 {
+    constexpr std::size_t parallel_cell_threshold = 1 << 20;
 
     class heightmap : public ox::grid<int> {
         using ox::grid<int>::grid;
@@ -28,42 +33,182 @@ namespace day09 {
             return stdr::all_of(valid_neighbours, [value](auto a) { return *a > value; });
         }
 
-        int get_basin_size(const_raw_iterator index) {
-            std::unordered_set<const_raw_iterator, ox::iterator_hash<const_raw_iterator>> indices_in_basin{index};
-            std::queue<const_raw_iterator> dfs;
-            dfs.push(index);
-            while(!dfs.empty()) {
-                auto current = dfs.front();
-                dfs.pop();
-                indices_in_basin.insert(current);
-                auto neighbours = cardinal_neighbour_range(current);
-                for ( const_raw_iterator neighbour : neighbours
-                                                | const_valid_index()
-                                                | stdv::filter([](const_raw_iterator n) { return *n != 9; })
-                    ) {
-                    if (!indices_in_basin.contains(neighbour)) dfs.push(neighbour);
+        struct basin_summary {
+            std::vector<int> sizes;
+            long risk = 0;
+        };
+
+        // Single raster scan: every non-9 cell is unioned with its left and upper neighbours,
+        // and low points are scored on the way past
+        [[nodiscard]] basin_summary label_basins() const {
+            std::size_t height = data.size() / width;
+            std::vector<int> parent(data.size(), -1);
+            std::vector<int> size(data.size(), 1);
+
+            auto find = [&parent](int i) {
+                int root = i;
+                while (parent[root] != root)
+                    root = parent[root];
+                while (parent[i] != root)
+                    i = std::exchange(parent[i], root);
+                return root;
+            };
+            auto unite = [&](int a, int b) {
+                a = find(a);
+                b = find(b);
+                if (a == b)
+                    return;
+                if (size[a] < size[b])
+                    std::swap(a, b);
+                parent[b] = a;
+                size[a] += size[b];
+            };
+
+            basin_summary summary;
+            for (std::size_t y = 0; y < height; y++) {
+                for (std::size_t x = 0; x < width; x++) {
+                    int i = int(y * width + x);
+                    int value = data[i];
+                    bool low = (x == 0 || data[i - 1] > value)
+                               && (x + 1 == width || data[i + 1] > value)
+                               && (y == 0 || data[i - width] > value)
+                               && (y + 1 == height || data[i + width] > value);
+                    if (low)
+                        summary.risk += value + 1;
+                    if (value == 9)
+                        continue;
+                    parent[i] = i;
+                    if (x > 0 && data[i - 1] != 9)
+                        unite(i, i - 1);
+                    if (y > 0 && data[i - width] != 9)
+                        unite(i, int(i - width));
                 }
             }
-            return indices_in_basin.size();
+
+            for (int i = 0; i < int(data.size()); i++) {
+                if (parent[i] == i)
+                    summary.sizes.push_back(size[i]);
+            }
+            return summary;
+        }
+
+        // Rows are split into one band per thread and each band is labeled independently. Band borders are
+        // then merged with a lock-free union-find that always links the higher root under the lower one.
+        // Only the three largest basins are kept, as each band reduces its own candidates before merging.
+        [[nodiscard]] basin_summary label_basins_parallel(unsigned thread_count) const {
+            std::size_t height = data.size() / width;
+            thread_count = std::max(1u, std::min<unsigned>(thread_count, height));
+            std::vector<std::atomic<int>> parent(data.size());
+            std::vector<std::atomic<int>> size(data.size());
+
+            auto find = [&parent](int i) {
+                while (true) {
+                    int p = parent[i].load();
+                    if (p == i)
+                        return i;
+                    int grandparent = parent[p].load();
+                    if (grandparent != p)
+                        parent[i].compare_exchange_weak(p, grandparent);
+                    i = grandparent;
+                }
+            };
+            auto unite = [&](int a, int b) {
+                while (true) {
+                    a = find(a);
+                    b = find(b);
+                    if (a == b)
+                        return;
+                    if (a < b)
+                        std::swap(a, b);
+                    int expected = a;
+                    if (parent[a].compare_exchange_strong(expected, b))
+                        return;
+                }
+            };
+            auto band_start = [&](unsigned band) { return height * band / thread_count; };
+            auto for_each_band = [&](auto f) {
+                std::vector<std::jthread> workers;
+                for (unsigned band = 0; band < thread_count; band++)
+                    workers.emplace_back(f, band);
+            };
+
+            std::vector<long> band_risk(thread_count);
+            for_each_band([&](unsigned band) {
+                for (std::size_t y = band_start(band); y < band_start(band + 1); y++) {
+                    for (std::size_t x = 0; x < width; x++) {
+                        int i = int(y * width + x);
+                        int value = data[i];
+                        bool low = (x == 0 || data[i - 1] > value)
+                                   && (x + 1 == width || data[i + 1] > value)
+                                   && (y == 0 || data[i - width] > value)
+                                   && (y + 1 == height || data[i + width] > value);
+                        if (low)
+                            band_risk[band] += value + 1;
+                        parent[i] = value == 9 ? -1 : i;
+                        if (value == 9)
+                            continue;
+                        if (x > 0 && data[i - 1] != 9)
+                            unite(i, i - 1);
+                        if (y > band_start(band) && data[i - width] != 9)
+                            unite(i, int(i - width));
+                    }
+                }
+            });
+
+            for_each_band([&](unsigned band) {
+                std::size_t y = band_start(band);
+                if (band == 0 || y >= height)
+                    return;
+                for (std::size_t x = 0; x < width; x++) {
+                    int i = int(y * width + x);
+                    if (data[i] != 9 && data[i - width] != 9)
+                        unite(i, int(i - width));
+                }
+            });
+
+            for_each_band([&](unsigned band) {
+                for (std::size_t i = band_start(band) * width; i < band_start(band + 1) * width; i++) {
+                    if (data[i] != 9)
+                        size[find(int(i))].fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+
+            std::vector<std::array<int, 3>> band_top(thread_count);
+            for_each_band([&](unsigned band) {
+                auto& top = band_top[band];
+                for (std::size_t i = band_start(band) * width; i < band_start(band + 1) * width; i++) {
+                    int s = size[i].load(std::memory_order_relaxed);
+                    if (s > top[2]) {
+                        top[2] = s;
+                        stdr::sort(top, std::greater<>());
+                    }
+                }
+            });
+
+            basin_summary summary;
+            summary.risk = std::accumulate(band_risk.begin(), band_risk.end(), 0l);
+            for (const auto& top : band_top)
+                stdr::copy_if(top, std::back_inserter(summary.sizes), [](int s) { return s > 0; });
+            stdr::sort(summary.sizes, std::greater<>());
+            summary.sizes.resize(std::min<std::size_t>(summary.sizes.size(), 3));
+            return summary;
+        }
+
+        [[nodiscard]] basin_summary summarize_basins() const {
+            if (data.size() >= parallel_cell_threshold)
+                return label_basins_parallel(std::thread::hardware_concurrency());
+            return label_basins();
         }
 
-        int get_score() {
-            auto x = data
-                     | ox::ranges::views::iterators
-                     | stdv::filter([this] (auto x) { return is_low_point(x); })
-                     | stdv::transform([this] (auto x) { return *x + 1; });
-            return std::accumulate(x.begin(), x.end(), 0);
+        long get_score() {
+            return summarize_basins().risk;
         }
 
-        int get_score2() {
-            auto x = data
-                     | ox::ranges::views::iterators
-                     | stdv::filter([this] (auto x) { return is_low_point(x); })
-                     | stdv::transform([this] (auto x) { return get_basin_size(x); });
-            std::vector basin_sizes(x.begin(), x.end());
-            std::nth_element(basin_sizes.begin(), basin_sizes.begin() + 3, basin_sizes.end(), std::greater<int>{});
-            return std::accumulate(basin_sizes.begin(), basin_sizes.begin() + 3, 1, std::multiplies<int>());
-            return 0;
+        long get_score2() {
+            auto basin_sizes = summarize_basins().sizes;
+            auto top = std::min<std::size_t>(3, basin_sizes.size());
+            std::nth_element(basin_sizes.begin(), basin_sizes.begin() + top, basin_sizes.end(), std::greater<int>{});
+            return std::accumulate(basin_sizes.begin(), basin_sizes.begin() + top, 1l, std::multiplies<long>());
         }
 
         void print_array() {
@@ -81,11 +226,11 @@ namespace day09 {
         auto [x, y] = h.get_dimensions();
         printf("size = %zu x %zu\n", x, y);
         h.print_array();
-        printf("score = %d\n", h.get_score());
+        printf("score = %ld\n", h.get_score());
     }
 
     void puzzle2() {
         heightmap h(GET_STREAM(input, ox::line), [](char a) {return a - '0';});
-        printf("score = %d\n", h.get_score2());
+        printf("score = %ld\n", h.get_score2());
     }
 }
\ No newline at end of file
@@ -3,30 +3,68 @@
 //
 
 #include "day10.h"
-#include <stack>
 #include <numeric>
 #include <vector>
-#include <typeinfo>
+#include <array>
+#include <string_view>
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <barrier>
+#include <string>
 
 #define YEAR 2021
 #define DAY 10
 
 namespace day10 {
+    using completion_type = unsigned __int128;
+
+    struct bracket_info {
+        enum : uint8_t { other, open, close } kind = other;
+        char partner = 0;
+        int corruption_score = 0;
+        int completion_score = 0;
+    };
+
+    constexpr std::array<bracket_info, 256> bracket_table = [] {
+        std::array<bracket_info, 256> table{};
+        constexpr std::array<std::array<int, 4>, 4> pairs{{
+                {'(', ')', 3, 1},
+                {'[', ']', 57, 2},
+                {'{', '}', 1197, 3},
+                {'<', '>', 25137, 4},
+        }};
+        for (auto [open, close, corruption, completion] : pairs) {
+            table[open] = {bracket_info::open, char(close), 0, completion};
+            table[close] = {bracket_info::close, char(open), corruption, 0};
+        }
+        return table;
+    }();
+
+    constexpr const bracket_info& classify(char c) {
+        return bracket_table[static_cast<unsigned char>(c)];
+    }
+
+    // The open-bracket buffer only ever grows, so after the longest line no parse allocates
     class parser {
-        std::stack<char> state;
+        std::vector<char> state;
+        std::size_t depth = 0;
         char fail = 0;
     public:
-        parser(const std::string& s) {
-            for(char c : s) {
-                if (is_open(c)) {
-                    state.push(c);
+        void parse(std::string_view s) {
+            if (state.size() < s.size())
+                state.resize(s.size());
+            depth = 0;
+            fail = 0;
+            for (char c : s) {
+                const bracket_info& info = classify(c);
+                if (info.kind == bracket_info::open) {
+                    state[depth++] = c;
+                } else if (depth && state[depth - 1] == info.partner) {
+                    depth--;
                 } else {
-                    if (!state.empty() && match_close(state.top(), c))
-                        state.pop();
-                    else {
-                        fail = c;
-                        break;
-                    }
+                    fail = c;
+                    break;
                 }
             }
         }
@@ -35,77 +73,102 @@ namespace day10 {
             return fail;
         }
 
-        static bool is_close(char c) {
-            return (c == ')') || (c == ']') || (c == '>') || (c == '}');
-        }
-        static bool is_open(char c) {
-            return (c == '(') || (c == '[') || (c == '<') || (c == '{');
-        }
-        static bool match_close(char open, char close) {
-            switch(open) {
-                case '(': return close == ')';
-                case '{': return close == '}';
-                case '[': return close == ']';
-                case '<': return close == '>';
-                default: return false;
+        [[nodiscard]] completion_type get_completion_score() const {
+            completion_type sum = 0;
+            for (std::size_t i = depth; i-- > 0;) {
+                sum = sum * 5 + classify(state[i]).completion_score;
             }
+            return sum;
         }
-        static int close_to_score1(char c) {
-            switch(c) {
-                case ')': return 3;
-                case ']': return 57;
-                case '}': return 1197;
-                case '>': return 25137;
-                default: return 0;
-            }
+    };
+
+    struct chunk_result {
+        long corruption = 0;
+        std::vector<completion_type> completions;
+    };
+
+    // Lines are independent, so each worker validates a contiguous chunk with its own parser and
+    // leaves its completion scores sorted for the selection step
+    std::vector<chunk_result> validate(const std::vector<std::string>& lines,
+                                       unsigned thread_count = std::thread::hardware_concurrency()) {
+        thread_count = std::max(1u, thread_count);
+        std::size_t chunk_size = std::max<std::size_t>(1, (lines.size() + thread_count - 1) / thread_count);
+        std::vector<chunk_result> results((lines.size() + chunk_size - 1) / chunk_size);
+        std::vector<std::jthread> workers;
+        for (std::size_t chunk = 0; chunk < results.size(); chunk++) {
+            workers.emplace_back([&, chunk] {
+                parser p;
+                chunk_result& result = results[chunk];
+                auto end = std::min(lines.size(), (chunk + 1) * chunk_size);
+                for (std::size_t i = chunk * chunk_size; i < end; i++) {
+                    p.parse(lines[i]);
+                    if (p.get_fail())
+                        result.corruption += classify(p.get_fail()).corruption_score;
+                    else
+                        result.completions.push_back(p.get_completion_score());
+                }
+                std::sort(result.completions.begin(), result.completions.end());
+            });
         }
-        static int open_to_score2(char c) {
-            switch(c) {
-                case '(': return 1;
-                case '[': return 2;
-                case '{': return 3;
-                case '<': return 4;
-                default: return 0;
-            }
+        workers.clear();
+        return results;
+    }
+
+    // k-th smallest (0-based) over the union of the sorted per-chunk lists, found by bisecting on the value.
+    // Each chunk counts its entries at or below the probe on its own worker, and the barrier's
+    // completion step adds those counts and narrows the interval for the next round.
+    completion_type select(const std::vector<chunk_result>& results, std::size_t k) {
+        completion_type low = 0;
+        completion_type high = 0;
+        for (const auto& r : results) {
+            if (!r.completions.empty())
+                high = std::max(high, r.completions.back());
         }
+        if (low >= high)
+            return low;
 
-        [[nodiscard]] long get_completion_score() const {
-            std::stack temp{state};
-            long sum = 0;
-            while (!temp.empty()) {
-                sum *= 5;
-                sum += open_to_score2(temp.top());
-                temp.pop();
-            }
-            return sum;
+        std::vector<std::size_t> counts(results.size());
+        completion_type mid = low + (high - low) / 2;
+        bool done = false;
+        std::barrier sync(static_cast<std::ptrdiff_t>(results.size()), [&]() noexcept {
+            if (std::accumulate(counts.begin(), counts.end(), std::size_t{0}) > k)
+                high = mid;
+            else
+                low = mid + 1;
+            mid = low + (high - low) / 2;
+            done = low >= high;
+        });
+        std::vector<std::jthread> workers;
+        for (std::size_t chunk = 0; chunk < results.size(); chunk++) {
+            workers.emplace_back([&, chunk] {
+                const auto& completions = results[chunk].completions;
+                while (!done) {
+                    counts[chunk] = std::upper_bound(completions.begin(), completions.end(), mid) - completions.begin();
+                    sync.arrive_and_wait();
+                }
+            });
         }
-    };
+        workers.clear();
+        return low;
+    }
 
-    void puzzle1() {
+    std::vector<std::string> get_lines() {
         auto input = GET_STREAM(input, std::string);
+        return {input.begin(), input.end()};
+    }
 
-        auto scores = input
-                      | stdv::transform([](const parser& p) { return p.get_fail(); })
-                      | stdv::filter(std::identity())
-                      | stdv::transform(parser::close_to_score1);
-        auto x = std::accumulate(scores.begin(), scores.end(), 0);
-        printf("The score is %d\n", x);
+    void puzzle1() {
+        auto results = validate(get_lines());
+        auto corruption = results | stdv::transform(&chunk_result::corruption);
+        printf("The score is %ld\n", std::accumulate(corruption.begin(), corruption.end(), 0l));
     }
 
     void puzzle2() {
-        auto input = GET_STREAM(input, std::string);
-
-        auto scores_itr = input
-                      | stdv::filter([](const parser& p) { return !p.get_fail(); })
-                      | stdv::transform([](const parser& p) { return p.get_completion_score(); });
-
-        // For some reason, vector scores(scores_itr.being(), scores_itr.end()) does not work
-        // Also gcc error message suck, but also clang 13.0.0 doesn't have full ranges support :(
-        std::vector<long> scores/*(scores_itr.begin(), scores_itr.end())*/;
-        for (long x : scores_itr) {
-            scores.push_back(x);
-        }
-        std::nth_element(scores.begin(), scores.begin() + (scores.size()/2), scores.end());
-        printf("The score is %ld\n", scores[scores.size()/2]);
+        auto results = validate(get_lines());
+        auto sizes = results | stdv::transform([](const chunk_result& r) { return r.completions.size(); });
+        std::size_t total = std::accumulate(sizes.begin(), sizes.end(), std::size_t{0});
+        if (total == 0)
+            return;
+        printf("The score is %s\n", to_string(select(results, total / 2)).c_str());
     }
-}
\ No newline at end of file
+}
@@ -9,66 +9,253 @@
 #define DAY 11
 
 #include <vector>
-#include <unordered_set>
-#include <queue>
+#include <array>
+#include <cstdint>
 #include <numeric>
 #include <optional>
 #include <concepts>
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <random>
 #include <ox/grid.h>
 
 namespace day11 {
+    constexpr std::size_t parallel_cell_threshold = 1 << 16;
+
+    // The grid is copied once into a flat byte array with a one-cell border, so all eight neighbours of an
+    // interior cell are fixed offsets. Border cells are permanently marked as flashed and never propagate.
     class octopuses : public ox::grid<int> {
         using ox::grid<int>::grid;
+
+        std::size_t stride = 0;
+        std::vector<uint8_t> energy;
+        std::vector<uint64_t> flashed;
+        std::vector<uint32_t> stack;
+        std::array<std::ptrdiff_t, 8> offsets{};
+
+        [[nodiscard]] bool test(std::size_t i) const { return flashed[i / 64] >> (i % 64) & 1; }
+        void set(std::size_t i) { flashed[i / 64] |= uint64_t{1} << (i % 64); }
+        void reset(std::size_t i) { flashed[i / 64] &= ~(uint64_t{1} << (i % 64)); }
+
+        void pad() {
+            std::size_t height = data.size() / width;
+            stride = width + 2;
+            energy.assign(stride * (height + 2), 0);
+            flashed.assign((energy.size() + 63) / 64, 0);
+            stack.resize(data.size());
+            for (std::size_t i = 0; i < energy.size(); i++) {
+                std::size_t row = i / stride;
+                std::size_t column = i % stride;
+                if (row == 0 || row == height + 1 || column == 0 || column == width + 1)
+                    set(i);
+                else
+                    energy[i] = uint8_t(data[(row - 1) * width + column - 1]);
+            }
+            auto s = std::ptrdiff_t(stride);
+            offsets = {-s - 1, -s, -s + 1, -1, 1, s - 1, s, s + 1};
+        }
+
     public:
         auto get_size() {
             return data.size();
         }
 
         int next_step() {
-            std::unordered_set<raw_iterator, ox::iterator_hash<raw_iterator>> indices_flashed{};
-            std::queue<raw_iterator> dfs;
+            if (energy.empty())
+                pad();
+
+            for (uint8_t& e : energy)
+                e++;
 
-            for(auto& x : data | ox::ranges::views::iterators) {
-                if(++(*x) > 9) {
-                    dfs.push(x);
+            std::size_t top = 0;
+            for (std::size_t i = 0; i < energy.size(); i++) {
+                if (energy[i] > 9 && !test(i)) {
+                    set(i);
+                    stack[top++] = uint32_t(i);
                 }
             }
 
-            while (!dfs.empty()) {
-                raw_iterator current = dfs.front();
-                dfs.pop();
-                auto [in_iter, success] = indices_flashed.insert(current);
-                if (!success) {
-                    continue;
+            for (std::size_t head = 0; head < top; head++) {
+                std::size_t current = stack[head];
+                for (std::ptrdiff_t offset : offsets) {
+                    std::size_t neighbour = current + offset;
+                    if (++energy[neighbour] > 9 && !test(neighbour)) {
+                        set(neighbour);
+                        stack[top++] = uint32_t(neighbour);
+                    }
                 }
+            }
+
+            for (std::size_t i = 0; i < top; i++) {
+                energy[stack[i]] = 0;
+                reset(stack[i]);
+            }
+
+            return int(top);
+        }
+
+        // Rows of the padded array are split into one band per thread, and every band only writes its own cells.
+        // Increments that cross a band edge go to a halo outbox that the neighbouring band applies after a
+        // barrier, and rounds repeat until no band has pending flashes. A cell flashes exactly when its energy
+        // reaches 10, so no flashed bitset is shared between threads; border cells restart at 0 every step and
+        // can collect at most 4 increments.
+        int next_step_parallel(unsigned thread_count) {
+            if (energy.empty())
+                pad();
+            std::size_t rows = energy.size() / stride;
+            thread_count = std::max(1u, std::min<unsigned>(thread_count, rows));
+            auto band_start = [&](std::size_t band) { return rows * band / thread_count * stride; };
+            auto owner = [&](std::size_t i) {
+                std::size_t band = i / stride * thread_count / rows;
+                while (i < band_start(band))
+                    band--;
+                while (i >= band_start(band + 1))
+                    band++;
+                return band;
+            };
+            auto for_each_band = [&](auto f) {
+                std::vector<std::jthread> workers;
+                for (std::size_t band = 0; band < thread_count; band++)
+                    workers.emplace_back(f, band);
+            };
+
+            std::vector<std::vector<uint32_t>> pending(thread_count);
+            std::vector<std::vector<uint32_t>> flashes(thread_count);
+            std::vector<std::vector<uint32_t>> halo_up(thread_count);
+            std::vector<std::vector<uint32_t>> halo_down(thread_count);
 
-                auto neighbour = neighbour_range(current);
-                for(auto index : neighbour | valid_index()) {
-                    if (++(*index) > 9)
-                        dfs.push(index);
+            auto bump = [&](std::size_t band, std::size_t i) {
+                if (++energy[i] == 10) {
+                    pending[band].push_back(uint32_t(i));
+                    flashes[band].push_back(uint32_t(i));
                 }
+            };
+
+            for_each_band([&](std::size_t band) {
+                for (std::size_t i = band_start(band); i < band_start(band + 1); i++) {
+                    std::size_t column = i % stride;
+                    if (i < stride || i >= energy.size() - stride || column == 0 || column == stride - 1)
+                        energy[i] = 0;
+                    bump(band, i);
+                }
+            });
+
+            bool work = true;
+            while (work) {
+                for_each_band([&](std::size_t band) {
+                    halo_up[band].clear();
+                    halo_down[band].clear();
+                    auto& stack = pending[band];
+                    while (!stack.empty()) {
+                        std::size_t current = stack.back();
+                        stack.pop_back();
+                        std::size_t row = current / stride;
+                        if (row == 0 || row == rows - 1 || current % stride == 0 || current % stride == stride - 1)
+                            continue;
+                        for (std::ptrdiff_t offset : offsets) {
+                            std::size_t neighbour = current + offset;
+                            if (neighbour < band_start(band))
+                                halo_up[band].push_back(uint32_t(neighbour));
+                            else if (neighbour >= band_start(band + 1))
+                                halo_down[band].push_back(uint32_t(neighbour));
+                            else
+                                bump(band, neighbour);
+                        }
+                    }
+                });
+                for_each_band([&](std::size_t band) {
+                    auto receive = [&](const std::vector<uint32_t>& halo) {
+                        for (uint32_t i : halo) {
+                            if (owner(i) == band)
+                                bump(band, i);
+                        }
+                    };
+                    if (band > 0)
+                        receive(halo_down[band - 1]);
+                    if (band + 1 < thread_count)
+                        receive(halo_up[band + 1]);
+                });
+                work = stdr::any_of(pending, [](const auto& stack) { return !stack.empty(); });
             }
 
-            for (auto x : indices_flashed) {
-                *x = 0;
+            int total = 0;
+            for (const auto& band_flashes : flashes) {
+                for (uint32_t i : band_flashes) {
+                    std::size_t row = i / stride;
+                    std::size_t column = i % stride;
+                    if (row == 0 || row == rows - 1 || column == 0 || column == stride - 1)
+                        continue;
+                    energy[i] = 0;
+                    total++;
+                }
             }
+            return total;
+        }
+
+        int step(unsigned thread_count = std::thread::hardware_concurrency()) {
+            if (thread_count > 1 && data.size() >= parallel_cell_threshold)
+                return next_step_parallel(thread_count);
+            return next_step();
+        }
 
-            return indices_flashed.size();
+        [[nodiscard]] std::string state_key() {
+            if (energy.empty())
+                pad();
+            std::string key;
+            key.reserve(data.size());
+            for (std::size_t row = 1; row + 1 < energy.size() / stride; row++)
+                key.append(energy.begin() + row * stride + 1, energy.begin() + row * stride + 1 + width);
+            return key;
+        }
+
+        // Every visited state is remembered, so once one repeats the remaining steps are skipped a full
+        // period at a time
+        long flashes_after(long steps) {
+            std::unordered_map<std::string, long> seen;
+            std::vector<long> cumulative{0};
+            seen.emplace(state_key(), 0);
+            for (long current = 1; current <= steps; current++) {
+                cumulative.push_back(cumulative.back() + step());
+                auto [previous, inserted] = seen.emplace(state_key(), current);
+                if (inserted)
+                    continue;
+                long start = previous->second;
+                long period = current - start;
+                long per_period = cumulative[current] - cumulative[start];
+                long remaining = steps - current;
+                return cumulative[current] + remaining / period * per_period
+                       + (cumulative[start + remaining % period] - cumulative[start]);
+            }
+            return cumulative.back();
         }
 
         void print_array() {
-            leveled_foreach(
-                    [](int i) { printf("\033[%sm%4d\033[0m", i == 0 || i > 9 ? "31" : "0", i); },
-                    []() { printf("\n"); }
-            );
+            if (energy.empty())
+                pad();
+            for (std::size_t row = 1; row + 1 < energy.size() / stride; row++) {
+                for (std::size_t column = 1; column <= width; column++) {
+                    int i = energy[row * stride + column];
+                    printf("\033[%sm%4d\033[0m", i == 0 || i > 9 ? "31" : "0", i);
+                }
+                printf("\n");
+            }
         }
     };
 
+    octopuses generate_octopuses(std::size_t width, std::size_t height, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> digit('0', '9');
+        std::vector<std::string> rows(height, std::string(width, '0'));
+        for (auto& row : rows)
+            stdr::generate(row, [&] { return char(digit(rng)); });
+        return {rows, [](char a) { return a - '0'; }};
+    }
+
     void puzzle1() {
         int number_of_steps = 100;
         octopuses o(GET_STREAM(input, ox::line), [](char a) {return a - '0';});
-        auto scores = stdv::iota(0, number_of_steps) | stdv::transform([&o] (int) { return o.next_step(); });
-        printf("Number of flashes after %d steps: %d\n", number_of_steps, std::accumulate(scores.begin(), scores.end(), 0));
+        printf("Number of flashes after %d steps: %ld\n", number_of_steps, o.flashes_after(number_of_steps));
     }
 
     void puzzle2() {
@@ -12,11 +12,10 @@
 #include <optional>
 #include <unordered_map>
 #include <ranges>
-
-#define pushpop(p, a, X) \
-p.push_back(a);\
-X;\
-p.pop_back();
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iterator>
 
 namespace day12 {
     class link : public std::pair<std::string, std::string> {};
@@ -29,52 +28,187 @@ namespace day12 {
     }
 
     class graph {
+    public:
         using path = std::vector<std::string>;
-        std::unordered_multimap<std::string, std::string> links;
-
-        void _valid_paths_rec(path& p, std::vector<path>& out, int double_visited = true) {
-            std::string& curr = p.back();
-            auto [begin, end] = links.equal_range(curr);
-            for(const auto &[_, value] : stdr::subrange(begin, end)) {
-                if (value == "end") {
-                    pushpop(p, value, out.push_back(p))
-                } else if (std::isupper(value[0]) || std::find(p.begin(), p.end(), value) == p.end()) {
-                    pushpop(p, value, _valid_paths_rec(p, out, double_visited))
-                } else if (value != "start" && !double_visited ) {
-                    pushpop(p, value, _valid_paths_rec(p, out, true))
+        using path_filter = std::function<bool(const path&)>;
+        class path_generator;
+
+    private:
+        using cave_mask = uint64_t;
+
+        // Small caves own one bit of a cave_mask, big caves have a small_bit of -1.
+        std::unordered_map<std::string, int> cave_ids;
+        std::vector<std::string> names;
+        std::vector<std::vector<int>> adjacency;
+        std::vector<int> small_bit;
+        int small_count = 0;
+        int start_id, end_id;
+        // Paths to "end" keyed by visited mask, one table per (node, double visited)
+        std::vector<std::unordered_map<cave_mask, long>> memo;
+
+        int intern(const std::string& name) {
+            auto [it, inserted] = cave_ids.emplace(name, static_cast<int>(adjacency.size()));
+            if (inserted) {
+                adjacency.emplace_back();
+                names.push_back(name);
+                small_bit.push_back(std::isupper(name[0]) ? -1 : small_count++);
+                assert(small_count <= 64);
+            }
+            return it->second;
+        }
+
+        long _count_paths(int node, cave_mask visited, bool double_visited) {
+            if (node == end_id)
+                return 1;
+            auto& cache = memo[2 * node + double_visited];
+            if (auto it = cache.find(visited); it != cache.end())
+                return it->second;
+
+            long total = 0;
+            for (int next : adjacency[node]) {
+                int bit = small_bit[next];
+                cave_mask next_bit = bit < 0 ? 0 : cave_mask{1} << bit;
+                if (!(visited & next_bit)) {
+                    total += _count_paths(next, visited | next_bit, double_visited);
+                } else if (next != start_id && !double_visited) {
+                    total += _count_paths(next, visited, true);
                 }
             }
+            cache.emplace(visited, total);
+            return total;
         }
 
     public:
         template<stdr::range R>
         explicit graph(R& r) {
             for (const link& l : r) {
-                links.emplace(l.first, l.second);
-                links.emplace(l.second, l.first);
+                int a = intern(l.first), b = intern(l.second);
+                adjacency[a].push_back(b);
+                adjacency[b].push_back(a);
             }
+            start_id = intern("start");
+            end_id = intern("end");
+            memo.resize(2 * adjacency.size());
         }
 
-        std::vector<path> get_valid_paths(bool with_return = false) {
-            path p{"start"};
-            p.reserve(links.size() * 3);
-            std::vector<path> out;
-            _valid_paths_rec(p, out, !with_return);
-            return out;
+        long count_paths(bool with_return = false) {
+            return _count_paths(start_id, cave_mask{1} << small_bit[start_id], !with_return);
         }
+
+        // Lazily walks every valid path, see path_generator. The graph must outlive it.
+        path_generator paths(bool with_return = false, path_filter filter = {}, size_t limit = SIZE_MAX) const;
+
+        std::vector<path> get_valid_paths(bool with_return = false) const;
     };
 
+    // Depth first walk with an explicit stack, yielding each path that reaches "end"
+    // from a single reused buffer. Memory is O(depth) regardless of the path count.
+    // Paths rejected by the filter are skipped, and the walk stops after limit paths.
+    class graph::path_generator {
+        struct frame {
+            int node;
+            size_t edge;
+            cave_mask visited;
+            bool double_visited;
+        };
+
+        const graph* g;
+        path_filter filter;
+        size_t remaining;
+        std::vector<frame> stack;
+        path current;
+        bool at_end = false;
+
+        bool advance() {
+            if (at_end) {
+                current.pop_back();
+                at_end = false;
+            }
+            while (remaining && !stack.empty()) {
+                auto [node, edge, visited, double_visited] = stack.back();
+                if (edge == g->adjacency[node].size()) {
+                    stack.pop_back();
+                    current.pop_back();
+                    continue;
+                }
+                ++stack.back().edge;
+                int next = g->adjacency[node][edge];
+                current.push_back(g->names[next]);
+
+                if (next == g->end_id) {
+                    if (!filter || filter(current)) {
+                        at_end = true;
+                        --remaining;
+                        return true;
+                    }
+                    current.pop_back();
+                    continue;
+                }
+
+                int bit = g->small_bit[next];
+                cave_mask next_bit = bit < 0 ? 0 : cave_mask{1} << bit;
+                if (!(visited & next_bit)) {
+                    stack.push_back({next, 0, visited | next_bit, double_visited});
+                } else if (next != g->start_id && !double_visited) {
+                    stack.push_back({next, 0, visited, true});
+                } else {
+                    current.pop_back();
+                }
+            }
+            return false;
+        }
+
+    public:
+        path_generator(const graph& g, bool with_return, path_filter filter, size_t limit)
+                : g(&g), filter(std::move(filter)), remaining(limit) {
+            stack.push_back({g.start_id, 0, cave_mask{1} << g.small_bit[g.start_id], !with_return});
+            current.push_back("start");
+        }
+
+        class iterator {
+            path_generator* gen;
+        public:
+            using value_type = path;
+            using difference_type = std::ptrdiff_t;
+
+            iterator() : gen(nullptr) {}
+            explicit iterator(path_generator* gen) : gen(gen) { ++*this; }
+
+            const path& operator*() const { return gen->current; }
+            iterator& operator++() {
+                if (!gen->advance())
+                    gen = nullptr;
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+            bool operator==(std::default_sentinel_t) const { return gen == nullptr; }
+        };
+
+        // Single pass: begin() resumes the walk where the last iterator left off
+        iterator begin() { return iterator(this); }
+        std::default_sentinel_t end() { return {}; }
+    };
+
+    graph::path_generator graph::paths(bool with_return, path_filter filter, size_t limit) const {
+        return {*this, with_return, std::move(filter), limit};
+    }
+
+    std::vector<graph::path> graph::get_valid_paths(bool with_return) const {
+        std::vector<path> out;
+        for (const path& p : paths(with_return))
+            out.push_back(p);
+        return out;
+    }
+
     void puzzle1() {
         auto input = GET_STREAM(input, link);
         graph g(input);
-        auto paths = g.get_valid_paths();
-        printf("Number of unique paths is: %zu\n", paths.size());
+        printf("Number of unique paths is: %ld\n", g.count_paths());
     }
 
     void puzzle2() {
         auto input = GET_STREAM(input, link);
         graph g(input);
-        auto paths = g.get_valid_paths(true);
-        printf("Number of unique paths is: %zu\n", paths.size());
+        printf("Number of unique paths is: %ld\n", g.count_paths(true));
     }
 }
@@ -15,68 +15,244 @@
 #include <optional>
 #include <concepts>
 #include <algorithm>
+#include <span>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 
 namespace day13 {
     struct fold : public std::pair<char, int> {};
 
+    // Bit-packed paper: dot (x, y) is bit x % 64 of word y * stride + x / 64.
+    // The stride is fixed by the original width, folds only shrink the live area.
+    class bitmap {
+        using point = std::pair<int, int>;
+        using word = uint64_t;
+        using word_vector = word __attribute__((vector_size(32)));
+        static constexpr int word_bits = 64;
+        static constexpr int vector_words = sizeof(word_vector) / sizeof(word);
+
+        int stride;
+        std::vector<word> bits;
+        std::vector<word> reversed;
+        std::vector<word> shifted;
+
+        word* row(int y) { return bits.data() + static_cast<std::size_t>(y) * stride; }
+        const word* row(int y) const { return bits.data() + static_cast<std::size_t>(y) * stride; }
+
+        static word reverse_bits(word w) {
+            w = (w >> 1 & 0x5555555555555555) | (w & 0x5555555555555555) << 1;
+            w = (w >> 2 & 0x3333333333333333) | (w & 0x3333333333333333) << 2;
+            w = (w >> 4 & 0x0F0F0F0F0F0F0F0F) | (w & 0x0F0F0F0F0F0F0F0F) << 4;
+            return __builtin_bswap64(w);
+        }
+
+        static void or_into(word* dst, const word* src, int n) {
+            int i = 0;
+            for (; i + vector_words <= n; i += vector_words) {
+                word_vector a, b;
+                std::memcpy(&a, dst + i, sizeof a);
+                std::memcpy(&b, src + i, sizeof b);
+                a |= b;
+                std::memcpy(dst + i, &a, sizeof a);
+            }
+            for (; i < n; ++i)
+                dst[i] |= src[i];
+        }
+
+        // out = in shifted towards lower bit positions by s (towards higher ones if s < 0)
+        void shift_into(const std::vector<word>& in, std::vector<word>& out, long s) const {
+            long q = (s < 0 ? -s : s) / word_bits;
+            int r = static_cast<int>((s < 0 ? -s : s) % word_bits);
+            auto at = [&](long i) { return 0 <= i && i < stride ? in[i] : word{0}; };
+            for (long i = 0; i < stride; ++i) {
+                if (s >= 0)
+                    out[i] = at(i + q) >> r | (r ? at(i + q + 1) << (word_bits - r) : 0);
+                else
+                    out[i] = at(i - q) << r | (r ? at(i - q - 1) >> (word_bits - r) : 0);
+            }
+        }
+
+    public:
+        bitmap(point dimensions, const std::vector<point>& points)
+                : stride((dimensions.first + word_bits - 1) / word_bits),
+                  bits(static_cast<std::size_t>(stride) * dimensions.second),
+                  reversed(stride), shifted(stride) {
+            for (auto [x, y] : points)
+                row(y)[x / word_bits] |= word{1} << (x % word_bits);
+        }
+
+        [[nodiscard]] bool test(point p) const {
+            return row(p.second)[p.first / word_bits] >> (p.first % word_bits) & 1;
+        }
+
+        // Rows below the crease are ORed onto their mirror, the crease and below are cleared
+        void fold_y(int crease, int height) {
+            for (int k = 1; crease + k < height; ++k)
+                or_into(row(crease - k), row(crease + k), stride);
+            std::fill(row(crease), row(height), 0);
+        }
+
+        // Each row is bit-reversed, realigned so column crease + k lands on crease - k,
+        // then ORed back and masked to the columns left of the crease
+        void fold_x(int crease, int height) {
+            long s = static_cast<long>(stride) * word_bits - 1 - 2l * crease;
+            for (int y = 0; y < height; ++y) {
+                word* r = row(y);
+                for (int i = 0; i < stride; ++i)
+                    reversed[stride - 1 - i] = reverse_bits(r[i]);
+                shift_into(reversed, shifted, s);
+                for (int i = 0; i < stride; ++i) {
+                    long low = static_cast<long>(i) * word_bits;
+                    word keep = crease <= low ? 0
+                              : crease >= low + word_bits ? ~word{0}
+                              : (word{1} << (crease - low)) - 1;
+                    r[i] = (r[i] | shifted[i]) & keep;
+                }
+            }
+        }
+
+        [[nodiscard]] std::size_t count(int height) const {
+            std::size_t total = 0;
+            for (const word* w = row(0); w != row(height); ++w)
+                total += __builtin_popcountll(*w);
+            return total;
+        }
+
+        [[nodiscard]] std::vector<point> to_points(point dimensions) const {
+            std::vector<point> out;
+            for (int y = 0; y < dimensions.second; ++y)
+                for (int i = 0; i < stride; ++i)
+                    for (word w = row(y)[i]; w; w &= w - 1)
+                        out.emplace_back(i * word_bits + __builtin_ctzll(w), y);
+            stdr::sort(out);
+            return out;
+        }
+    };
+
+    enum class representation {
+        automatic,
+        sparse,
+        dense
+    };
+
     struct paper {
         using point = std::pair<int, int>;
-        std::set<point> points;
+        using instruction = day13::fold;
+        // The bitmap is used when the area costs at most this many bits per dot
+        static constexpr long dense_bits_per_point = 64;
+
+        // Kept sorted and unique, empty while the bitmap is in use
+        std::vector<point> points;
+        std::optional<bitmap> dense;
         point dimensions;
 
-        void foldY(int cress) {
-            std::set<point> new_set;
-            for (point p : points) {
-                if (p.second < cress)
-                    new_set.insert(p);
-                if (p.second > cress)
-                    new_set.insert({p.first, 2 * cress - p.second});
+        // Table entry for a coordinate that lands on a crease. Mirrored coordinates can be
+        // negative when a fold is past the middle, so no small value is free to mean this.
+        static constexpr int dropped = std::numeric_limits<int>::min();
+
+        // Composes every fold along one axis into a table from original coordinate
+        // (starting at `low`) to final coordinate
+        static std::vector<int> compose_axis(int low, int high, std::span<const instruction> folds, char axis) {
+            std::vector<int> table(high - low + 1);
+            std::iota(table.begin(), table.end(), low);
+            for (const instruction& f : folds) {
+                if (f.first != axis)
+                    continue;
+                for (int& t : table) {
+                    if (t == dropped)
+                        continue;
+                    if (t == f.second)
+                        t = dropped;
+                    else if (t > f.second)
+                        t = 2 * f.second - t;
+                }
             }
-            points = new_set;
-            dimensions.second = cress;
+            return table;
         }
 
-        void foldX(int cress) {
-            std::set<point> new_set;
-            for (point p : points) {
-                if (p.first < cress)
-                    new_set.insert(p);
-                if (p.first > cress)
-                    new_set.insert({2 * cress - p.first, p.second});
-            }
-            points = new_set;
-            dimensions.first = cress;
+        void deduplicate() {
+            stdr::sort(points);
+            auto [first, last] = stdr::unique(points);
+            points.erase(first, last);
         }
     public:
-        explicit paper(std::istream& in) {
+        explicit paper(std::istream& in, representation mode = representation::automatic) {
             std::string s;
             while(std::getline(in, s) && !s.empty()) {
                 point p;
                 std::sscanf(s.c_str(), "%d,%d", &p.first, &p.second);
-                points.insert(p);
+                points.push_back(p);
             }
+            deduplicate();
             dimensions.first = stdr::max(points | stdv::transform(&point::first)) + 1;
             dimensions.second = stdr::max(points | stdv::transform(&point::second)) + 1;
+
+            long area = static_cast<long>(dimensions.first) * dimensions.second;
+            if (mode == representation::dense
+                || (mode == representation::automatic && area <= dense_bits_per_point * static_cast<long>(points.size()))) {
+                dense.emplace(dimensions, points);
+                points = {};
+            }
+        }
+
+        [[nodiscard]] bool contains(point p) const {
+            return dense ? dense->test(p) : std::binary_search(points.begin(), points.end(), p);
         }
 
         void print_paper(int limit = 100) {
             for(int j : stdv::iota(0, std::min(dimensions.second, limit))) {
                 for (int i : stdv::iota(0,  std::min(dimensions.first, limit))) {
-                    printf("%s", points.contains({i, j}) ? "\033[41m \033[0m" : " ");
+                    printf("%s", contains({i, j}) ? "\033[41m \033[0m" : " ");
                 }
                 printf("\n");
             }
         }
 
-        void fold(fold f) {
-            if (f.first == 'y')
-                foldY(f.second);
-            else
-                foldX(f.second);
+        // The bitmap folds one instruction at a time. A fold past the middle would need negative
+        // coordinates, so the paper drops back to the sparse points from there on.
+        // Sparse paper applies all folds at once: each point goes through the composed tables a single time
+        void fold(std::span<const instruction> folds) {
+            for (; dense && !folds.empty(); folds = folds.subspan(1)) {
+                auto [axis, crease] = folds.front();
+                int& size = axis == 'x' ? dimensions.first : dimensions.second;
+                if (2 * crease < size - 1) {
+                    points = dense->to_points(dimensions);
+                    dense.reset();
+                    break;
+                }
+                if (axis == 'x')
+                    dense->fold_x(crease, dimensions.second);
+                else
+                    dense->fold_y(crease, dimensions.second);
+                size = crease;
+            }
+            if (folds.empty())
+                return;
+
+            if (!points.empty()) {
+                // Earlier folds past the middle can leave negative coordinates, so the tables
+                // cover the range the dots actually occupy
+                auto [x_low, x_high] = stdr::minmax(points | stdv::transform(&point::first));
+                auto [y_low, y_high] = stdr::minmax(points | stdv::transform(&point::second));
+                std::vector<int> x_map = compose_axis(x_low, x_high, folds, 'x');
+                std::vector<int> y_map = compose_axis(y_low, y_high, folds, 'y');
+                std::erase_if(points, [&](point& p) {
+                    p = {x_map[p.first - x_low], y_map[p.second - y_low]};
+                    return p.first == dropped || p.second == dropped;
+                });
+                deduplicate();
+            }
+            for (const instruction& f : folds)
+                (f.first == 'x' ? dimensions.first : dimensions.second) = f.second;
+        }
+
+        void fold(const instruction& f) {
+            fold(std::span(&f, 1));
         }
 
         auto point_count() {
-            return points.size();
+            return dense ? dense->count(dimensions.second) : points.size();
         }
     };
 
@@ -97,9 +273,8 @@ namespace day13 {
     void puzzle2() {
         auto input = GET_STREAM(input, fold);
         paper p(input);
-        for (auto f : input) {
-            p.fold(f);
-        }
+        std::vector<fold> folds(input.begin(), input.end());
+        p.fold(folds);
         p.print_paper();
     }
 }
@@ -4,10 +4,13 @@
 
 #include <cassert>
 #include <set>
-#include <map>
+#include <array>
 #include <algorithm>
 #include <limits>
 #include <cmath>
+#include <vector>
+#include <string>
+#include <bit>
 #include "day14.h"
 
 #define YEAR 2021
@@ -25,63 +28,181 @@ namespace day14 {
         return in;
     }
 
+    using count_type = unsigned __int128;
+
+    // Row-major square matrix over the reachable pairs; `overflowed` carries over into products
+    struct expansion_matrix {
+        std::size_t n;
+        std::vector<count_type> m;
+        bool overflowed = false;
+
+        explicit expansion_matrix(std::size_t n) : n(n), m(n * n) {}
+
+        count_type& at(std::size_t i, std::size_t j) { return m[i * n + j]; }
+        count_type at(std::size_t i, std::size_t j) const { return m[i * n + j]; }
+
+        // Zero entries of the left operand skip their whole row of the right one,
+        // which keeps the early, mostly empty powers cheap
+        expansion_matrix operator*(const expansion_matrix& other) const {
+            expansion_matrix r(n);
+            r.overflowed = overflowed || other.overflowed;
+            for (std::size_t i = 0; i < n; i++) {
+                for (std::size_t k = 0; k < n; k++) {
+                    if (!at(i, k))
+                        continue;
+                    for (std::size_t j = 0; j < n; j++)
+                        r.at(i, j) = checked_add(r.at(i, j), checked_mul(at(i, k), other.at(k, j), r.overflowed), r.overflowed);
+                }
+            }
+            return r;
+        }
+
+        // Row vector times matrix
+        std::vector<count_type> apply(const std::vector<count_type>& v, bool& overflowed) const {
+            std::vector<count_type> r(n);
+            for (std::size_t k = 0; k < n; k++) {
+                if (!v[k])
+                    continue;
+                for (std::size_t j = 0; j < n; j++)
+                    r[j] = checked_add(r[j], checked_mul(v[k], at(k, j), overflowed), overflowed);
+            }
+            return r;
+        }
+    };
+
     class polymer_decoding {
+        static constexpr int elements = 26;
+        static constexpr int pairs = elements * elements;
+        static constexpr char no_rule = 0;
+
+        using pair_counts = std::array<long, pairs>;
+
         std::string current_template;
-        std::map<std::string, char, std::less<>> insertion_rules;
+        // Element inserted between each pair, indexed by pair_index
+        std::array<char, pairs> insertion_rules{};
+
+        static int element_index(char c) {
+            return c - 'A';
+        }
 
-        std::unordered_map<std::string, long> _multistep_imp(int max) {
-            std::unordered_map<std::string, long> pair_count;
+        static int pair_index(char a, char b) {
+            return element_index(a) * elements + element_index(b);
+        }
+
+        pair_counts _multistep_imp(int max) {
+            std::array<pair_counts, 2> buffers{};
+            pair_counts* pair_count = &buffers[0];
+            pair_counts* new_pair_count = &buffers[1];
             for(auto point = current_template.begin(); point+1 < current_template.end(); ++point) {
-                pair_count[std::string(point, point + 2)]++;
+                (*pair_count)[pair_index(point[0], point[1])]++;
             }
-            for(int iteration : stdv::iota(0, max)) {
-                std::unordered_map<std::string, long> new_pair_count;
-                for(auto& [pair, count] : pair_count) {
-                    auto rule = insertion_rules.find(pair);
-                    if (rule == insertion_rules.end())
+            for (int i = 0; i < max; i++) {
+                new_pair_count->fill(0);
+                for (int pair : stdv::iota(0, pairs)) {
+                    long count = (*pair_count)[pair];
+                    if (count == 0 || insertion_rules[pair] == no_rule)
                         continue;
-                    new_pair_count[std::string({pair[0], rule->second})] += count;
-                    new_pair_count[std::string({rule->second, pair[1]})] += count;
+                    int inserted = element_index(insertion_rules[pair]);
+                    (*new_pair_count)[pair / elements * elements + inserted] += count;
+                    (*new_pair_count)[inserted * elements + pair % elements] += count;
                 }
-                pair_count = std::move(new_pair_count);
+                std::swap(pair_count, new_pair_count);
             }
-            return pair_count;
+            return *pair_count;
         }
     public:
         polymer_decoding(ox::ifstream_container<insertion_rule>& in) {
             getline(in, current_template);
             in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-            for (auto& node : in) {
-                insertion_rules.insert(node);
+            for (auto& [pair, inserted] : in) {
+                insertion_rules[pair_index(pair[0], pair[1])] = inserted;
             }
         }
 
         void step() {
             current_template.reserve(current_template.size() * 2);
-            for(auto point = current_template.begin(); point+1 <= current_template.end(); ++point) {
-                std::string_view part(point, point+2);
-                auto rule = insertion_rules.find(part);
-                if (rule == insertion_rules.end())
+            for(auto point = current_template.begin(); point+1 < current_template.end(); ++point) {
+                char rule = insertion_rules[pair_index(point[0], point[1])];
+                if (rule == no_rule)
                     continue;
-                current_template.insert(++point, rule->second);
+                point = current_template.insert(++point, rule);
             }
         }
 
-        std::unordered_map<char, long> multistep(int max) {
+        // Every element starts exactly one pair except the last one of the template
+        std::array<long, elements> multistep(int max) {
             auto pair_count = _multistep_imp(max);
-            std::unordered_map<char, long> character_count;
-            character_count[current_template.front()]++;
-            character_count[current_template.back()]++;
-            for (const auto& [pair, count] : pair_count) {
-                character_count[pair[0]] += count;
-                character_count[pair[1]] += count;
-            }
-            for (auto& [_, count] : character_count) {
-                count /= 2;
+            std::array<long, elements> character_count{};
+            character_count[element_index(current_template.back())]++;
+            for (int pair : stdv::iota(0, pairs)) {
+                character_count[pair / elements] += pair_count[pair];
             }
             return character_count;
         };
 
+        // Longest run multistep can count exactly in a long: after s steps there are
+        // (template length - 1) * 2^s pairs
+        [[nodiscard]] int exact_step_limit() const {
+            return std::numeric_limits<long>::digits - static_cast<int>(std::bit_width(current_template.size()));
+        }
+
+        // Same histogram as multistep, but one step is a matrix on the pairs reachable from
+        // the template and `steps` is reached by repeated squaring. Counts wrap modulo 2^128.
+        std::array<count_type, elements> expand(long steps, bool& overflowed) {
+            std::array<int, pairs> compact;
+            compact.fill(-1);
+            std::vector<int> active;
+            auto reach = [&](int pair) {
+                if (compact[pair] < 0) {
+                    compact[pair] = static_cast<int>(active.size());
+                    active.push_back(pair);
+                }
+            };
+            for(auto point = current_template.begin(); point+1 < current_template.end(); ++point) {
+                reach(pair_index(point[0], point[1]));
+            }
+            for (std::size_t i = 0; i < active.size(); i++) {
+                int pair = active[i];
+                if (insertion_rules[pair] == no_rule)
+                    continue;
+                int inserted = element_index(insertion_rules[pair]);
+                reach(pair / elements * elements + inserted);
+                reach(inserted * elements + pair % elements);
+            }
+
+            expansion_matrix base(active.size());
+            for (std::size_t i = 0; i < active.size(); i++) {
+                int pair = active[i];
+                if (insertion_rules[pair] == no_rule)
+                    continue;
+                int inserted = element_index(insertion_rules[pair]);
+                base.at(i, compact[pair / elements * elements + inserted])++;
+                base.at(i, compact[inserted * elements + pair % elements])++;
+            }
+
+            std::vector<count_type> pair_count(active.size());
+            for(auto point = current_template.begin(); point+1 < current_template.end(); ++point) {
+                pair_count[compact[pair_index(point[0], point[1])]]++;
+            }
+            overflowed = false;
+            for (; steps; steps >>= 1) {
+                if (steps & 1) {
+                    pair_count = base.apply(pair_count, overflowed);
+                    overflowed |= base.overflowed;
+                }
+                if (steps > 1)
+                    base = base * base;
+            }
+
+            std::array<count_type, elements> character_count{};
+            character_count[element_index(current_template.back())]++;
+            for (std::size_t i = 0; i < active.size(); i++) {
+                count_type& c = character_count[active[i] / elements];
+                c = checked_add(c, pair_count[i], overflowed);
+            }
+            return character_count;
+        }
+
         const std::string& get_polymer() {
             std::unordered_map<std::string, int> pair_count;
             for(auto point = current_template.begin(); point+1 <= current_template.end(); ++point) {
@@ -91,15 +212,34 @@ namespace day14 {
         }
     };
 
-    void solve_for(int steps) {
+    void solve_for(long steps) {
         auto input = GET_STREAM(input, insertion_rule);
         polymer_decoding p(input);
-        std::unordered_map<char, long> char_count = p.multistep(steps);
-        auto counts = char_count | stdv::transform(&std::unordered_map<char, long>::value_type::second);
+        if (steps <= p.exact_step_limit()) {
+            auto char_count = p.multistep(static_cast<int>(steps));
+            auto counts = char_count | stdv::filter([](long count) { return count != 0; });
+
+            auto [min, max] = stdr::minmax(counts);
+            printf("Min count after %ld steps is %ld and the max is %ld\nTheir difference is %ld\n",
+                   steps, min, max, max - min);
+            return;
+        }
 
+        bool overflowed;
+        auto char_count = p.expand(steps, overflowed);
+        auto counts = char_count | stdv::filter([](count_type count) { return count != 0; });
+        if (overflowed) {
+            // Wrapped counts no longer order like the real ones, so only report them
+            printf("Element counts after %ld steps (mod 2^128):\n", steps);
+            for (std::size_t e = 0; e < char_count.size(); e++) {
+                if (char_count[e])
+                    printf("%c: %s\n", char('A' + e), to_string(char_count[e]).c_str());
+            }
+            return;
+        }
         auto [min, max] = stdr::minmax(counts);
-        printf("Min count after %d steps is %ld and the max is %ld\nTheir difference is %ld\n",
-               steps, min, max, max - min);
+        printf("Min count after %ld steps is %s and the max is %s\nTheir difference is %s\n",
+               steps, to_string(min).c_str(), to_string(max).c_str(), to_string(max - min).c_str());
     }
 
     void puzzle1() {
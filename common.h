@@ -12,6 +12,7 @@
 #include <optional>
 #include <vector>
 #include <ranges>
+#include <string>
 #include <ox/io.h>
 #include <ox/std_abbreviation.h>
 
@@ -36,6 +37,30 @@ std::vector<type> get_##name() {\
 DEFINE_VECTOR_FROM_ISTREAM_INPUT_METHOD(input, type)\
 DEFINE_VECTOR_FROM_ISTREAM_INPUT_METHOD(sample_input, type)
 
+inline std::string to_string(unsigned __int128 n) {
+    std::string s;
+    do {
+        s.push_back(char('0' + int(n % 10)));
+        n /= 10;
+    } while (n);
+    return {s.rbegin(), s.rend()};
+}
+
+// Wrapping unsigned arithmetic; `overflowed` is set, never cleared, once an exact result is lost
+template <typename T>
+T checked_add(T a, T b, bool& overflowed) {
+    T r;
+    overflowed |= __builtin_add_overflow(a, b, &r);
+    return r;
+}
+
+template <typename T>
+T checked_mul(T a, T b, bool& overflowed) {
+    T r;
+    overflowed |= __builtin_mul_overflow(a, b, &r);
+    return r;
+}
+
 #define COMMON_HEADER\
     void puzzle1();\
     void puzzle2();\